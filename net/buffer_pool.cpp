@@ -0,0 +1,86 @@
+#include "buffer_pool.h"
+#include <utility>
+
+BufferLease::BufferLease(BufferPool *pool, std::unique_ptr<char[]> slab,
+                         std::size_t capacity, int sizeClass)
+    : pool_(pool), slab_(std::move(slab)), capacity_(capacity),
+      sizeClass_(sizeClass) {}
+
+BufferLease::BufferLease(BufferLease &&other) noexcept
+    : pool_(other.pool_), slab_(std::move(other.slab_)),
+      capacity_(other.capacity_), sizeClass_(other.sizeClass_) {
+  other.pool_ = nullptr;
+  other.capacity_ = 0;
+  other.sizeClass_ = -1;
+}
+
+BufferLease &BufferLease::operator=(BufferLease &&other) noexcept {
+  if (this != &other) {
+    release();
+    pool_ = other.pool_;
+    slab_ = std::move(other.slab_);
+    capacity_ = other.capacity_;
+    sizeClass_ = other.sizeClass_;
+    other.pool_ = nullptr;
+    other.capacity_ = 0;
+    other.sizeClass_ = -1;
+  }
+  return *this;
+}
+
+BufferLease::~BufferLease() { release(); }
+
+void BufferLease::release() {
+  if (pool_ && slab_) {
+    pool_->giveBack(std::move(slab_), sizeClass_);
+  }
+  pool_ = nullptr;
+  capacity_ = 0;
+  sizeClass_ = -1;
+}
+
+BufferPool::BufferPool() {
+  // Returning a slab never has to grow a free list
+  for (auto &freeList : freeLists_) {
+    freeList.reserve(kMaxIdlePerClass);
+  }
+}
+
+BufferPool &BufferPool::shared() {
+  static BufferPool pool;
+  return pool;
+}
+
+BufferLease BufferPool::acquire(std::size_t wanted) {
+  int sizeClass = kClassCount - 1;
+  for (int i = 0; i < kClassCount; ++i) {
+    if (wanted <= kClassBytes[i]) {
+      sizeClass = i;
+      break;
+    }
+  }
+  std::unique_ptr<char[]> slab;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &freeList = freeLists_[sizeClass];
+    if (!freeList.empty()) {
+      slab = std::move(freeList.back());
+      freeList.pop_back();
+    }
+  }
+  if (!slab) {
+    slab.reset(new char[kClassBytes[sizeClass]]);
+  }
+  return BufferLease(this, std::move(slab), kClassBytes[sizeClass], sizeClass);
+}
+
+void BufferPool::giveBack(std::unique_ptr<char[]> slab, int sizeClass) {
+  if (sizeClass < 0 || sizeClass >= kClassCount) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &freeList = freeLists_[sizeClass];
+  if (freeList.size() < kMaxIdlePerClass) {
+    freeList.push_back(std::move(slab));
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class BufferPool;
+
+// A pooled slab borrowed for the duration of one read. The slab goes back to
+// its size class when the lease is destroyed.
+class BufferLease {
+public:
+    BufferLease() = default;
+    BufferLease(BufferLease&& other) noexcept;
+    BufferLease& operator=(BufferLease&& other) noexcept;
+    BufferLease(const BufferLease&) = delete;
+    BufferLease& operator=(const BufferLease&) = delete;
+    ~BufferLease();
+
+    char* data() const { return slab_.get(); }
+    std::size_t capacity() const { return capacity_; }
+    explicit operator bool() const { return static_cast<bool>(slab_); }
+
+private:
+    friend class BufferPool;
+    BufferLease(BufferPool* pool, std::unique_ptr<char[]> slab, std::size_t capacity, int sizeClass);
+    void release();
+
+    BufferPool* pool_ = nullptr;
+    std::unique_ptr<char[]> slab_;
+    std::size_t capacity_ = 0;
+    int sizeClass_ = -1;
+};
+
+// Size-classed slab pool shared by every tunneled stream. Idle connections
+// hold no buffer at all; a slab is borrowed only once the socket is readable.
+class BufferPool {
+public:
+    static constexpr std::size_t kSmallSlab = 4 * 1024;
+    static constexpr std::size_t kMediumSlab = 16 * 1024;
+    static constexpr std::size_t kLargeSlab = 64 * 1024;
+
+    static BufferPool& shared();
+
+    BufferPool();
+
+    // Borrows the smallest slab that holds `wanted` bytes (capped at kLargeSlab).
+    BufferLease acquire(std::size_t wanted);
+
+private:
+    friend class BufferLease;
+    static constexpr int kClassCount = 3;
+    static constexpr std::array<std::size_t, kClassCount> kClassBytes{{kSmallSlab, kMediumSlab, kLargeSlab}};
+    // Idle slabs retained per class; extra returns are freed.
+    static constexpr std::size_t kMaxIdlePerClass = 64;
+
+    void giveBack(std::unique_ptr<char[]> slab, int sizeClass);
+
+    std::mutex mutex_;
+    std::array<std::vector<std::unique_ptr<char[]>>, kClassCount> freeLists_;
+};
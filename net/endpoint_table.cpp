@@ -0,0 +1,118 @@
+#include "endpoint_table.h"
+
+#include <cstring>
+
+UdpSessionId readSessionId(const char* wire) {
+    UdpSessionId id = 0;
+    for (std::size_t i = 0; i < kUdpSessionIdBytes; ++i) {
+        id |= static_cast<UdpSessionId>(static_cast<std::uint8_t>(wire[i])) << (8 * i);
+    }
+    return id;
+}
+
+void writeSessionId(UdpSessionId id, char* wire) {
+    for (std::size_t i = 0; i < kUdpSessionIdBytes; ++i) {
+        wire[i] = static_cast<char>((id >> (8 * i)) & 0xFF);
+    }
+}
+
+EndpointKey EndpointKey::from(const boost::asio::ip::udp::endpoint& endpoint) {
+    EndpointKey key;
+    const auto address = endpoint.address();
+    if (address.is_v4()) {
+        const auto bytes = address.to_v4().to_bytes();
+        key.addr[10] = 0xFF;
+        key.addr[11] = 0xFF;
+        std::memcpy(key.addr.data() + 12, bytes.data(), bytes.size());
+    } else {
+        const auto bytes = address.to_v6().to_bytes();
+        std::memcpy(key.addr.data(), bytes.data(), bytes.size());
+    }
+    key.port = endpoint.port();
+    return key;
+}
+
+EndpointTable::EndpointTable(std::size_t initialCapacity) {
+    std::size_t capacity = 16;
+    while (capacity < initialCapacity) {
+        capacity <<= 1;
+    }
+    slots_.resize(capacity);
+    mask_ = capacity - 1;
+}
+
+std::size_t EndpointTable::hash(const EndpointKey& key) {
+    // FNV-1a over the address, then a 64-bit finalizer to spread the port
+    std::uint64_t h = 1469598103934665603ULL;
+    for (std::uint8_t byte : key.addr) {
+        h = (h ^ byte) * 1099511628211ULL;
+    }
+    h ^= key.port;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<std::size_t>(h);
+}
+
+std::size_t EndpointTable::probe(const EndpointKey& key) const {
+    std::size_t index = hash(key) & mask_;
+    while (slots_[index].used && !(slots_[index].key == key)) {
+        index = (index + 1) & mask_;
+    }
+    return index;
+}
+
+const UdpSessionId* EndpointTable::find(const EndpointKey& key) const {
+    const Slot& slot = slots_[probe(key)];
+    return slot.used ? &slot.id : nullptr;
+}
+
+void EndpointTable::insert(const EndpointKey& key, UdpSessionId id) {
+    if ((size_ + 1) * 2 > slots_.size()) {
+        grow();
+    }
+    Slot& slot = slots_[probe(key)];
+    if (!slot.used) {
+        slot.used = true;
+        slot.key = key;
+        ++size_;
+    }
+    slot.id = id;
+}
+
+bool EndpointTable::erase(const EndpointKey& key) {
+    std::size_t hole = probe(key);
+    if (!slots_[hole].used) {
+        return false;
+    }
+    slots_[hole].used = false;
+    --size_;
+    // Backward-shift the rest of the cluster so probes never need tombstones
+    std::size_t next = (hole + 1) & mask_;
+    while (slots_[next].used) {
+        const std::size_t home = hash(slots_[next].key) & mask_;
+        const bool movable = (next > hole) ? (home <= hole || home > next)
+                                           : (home <= hole && home > next);
+        if (movable) {
+            slots_[hole] = slots_[next];
+            slots_[next].used = false;
+            hole = next;
+        }
+        next = (next + 1) & mask_;
+    }
+    return true;
+}
+
+void EndpointTable::grow() {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(old.size() * 2);
+    mask_ = slots_.size() - 1;
+    size_ = 0;
+    for (const Slot& slot : old) {
+        if (slot.used) {
+            slots_[probe(slot.key)] = slot;
+            ++size_;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/asio.hpp>
+
+// Tunnel session id: the 6 wire bytes packed into an integer.
+using UdpSessionId = std::uint64_t;
+
+constexpr std::size_t kUdpSessionIdBytes = 6;
+
+UdpSessionId readSessionId(const char* wire);
+void writeSessionId(UdpSessionId id, char* wire);
+
+// Raw address bytes plus port; IPv4 is stored v4-mapped so both families
+// share one fixed-size key. Built without touching the heap.
+struct EndpointKey {
+    std::array<std::uint8_t, 16> addr{};
+    std::uint16_t port = 0;
+
+    static EndpointKey from(const boost::asio::ip::udp::endpoint& endpoint);
+    bool operator==(const EndpointKey& other) const {
+        return port == other.port && addr == other.addr;
+    }
+};
+
+// Open-addressed (linear probing, backward-shift delete) map from a UDP
+// client endpoint to its tunnel session id. Lookups never allocate; the slot
+// array only grows on insert once the load factor passes 1/2.
+class EndpointTable {
+public:
+    explicit EndpointTable(std::size_t initialCapacity = 64);
+
+    // Returns nullptr when the endpoint has no session.
+    const UdpSessionId* find(const EndpointKey& key) const;
+    void insert(const EndpointKey& key, UdpSessionId id);
+    bool erase(const EndpointKey& key);
+    std::size_t size() const { return size_; }
+
+private:
+    struct Slot {
+        EndpointKey key;
+        UdpSessionId id = 0;
+        bool used = false;
+    };
+
+    static std::size_t hash(const EndpointKey& key);
+    std::size_t probe(const EndpointKey& key) const;
+    void grow();
+
+    std::vector<Slot> slots_;
+    std::size_t mask_;
+    std::size_t size_ = 0;
+};
@@ -1,6 +1,8 @@
 #include "heartbeat_manager.h"
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <limits>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -8,7 +10,59 @@
 #include <arpa/inet.h>
 #endif
 
-HeartbeatManager::HeartbeatManager() : localIP_(0), running_(false) {
+namespace {
+// Requesters remembered per probed target until the next gossip round
+constexpr size_t kMaxRelayRequesters = 8;
+} // namespace
+
+bool VerifiedSourceTable::contains(uint32_t accountId, uint32_t ip) const {
+  const uint64_t key = keyFor(accountId, ip);
+  std::size_t index = slotFor(key);
+  for (std::size_t probes = 0; probes < kSlots; ++probes) {
+    const uint64_t slot = slots_[index].load(std::memory_order_acquire);
+    if (slot == key) {
+      return true;
+    }
+    if (slot == 0) {
+      return false;
+    }
+    index = (index + 1) & (kSlots - 1);
+  }
+  return false;
+}
+
+void VerifiedSourceTable::insert(uint32_t accountId, uint32_t ip) {
+  const uint64_t key = keyFor(accountId, ip);
+  if (accountId == 0 || size_ >= kMaxEntries) {
+    return;
+  }
+  std::size_t index = slotFor(key);
+  while (true) {
+    const uint64_t slot = slots_[index].load(std::memory_order_relaxed);
+    if (slot == key) {
+      return;
+    }
+    if (slot == 0) {
+      slots_[index].store(key, std::memory_order_release);
+      ++size_;
+      return;
+    }
+    index = (index + 1) & (kSlots - 1);
+  }
+}
+
+void VerifiedSourceTable::clear() {
+  if (size_ == 0) {
+    return;
+  }
+  for (auto &slot : slots_) {
+    slot.store(0, std::memory_order_release);
+  }
+  size_ = 0;
+}
+
+HeartbeatManager::HeartbeatManager()
+    : localIP_(0), running_(false), rng_(std::random_device{}()) {
   localNodeId_.fill(0);
 }
 
@@ -17,7 +71,6 @@ HeartbeatManager::~HeartbeatManager() { stop(); }
 void HeartbeatManager::initialize(const NodeID &localNodeId, uint32_t localIP) {
   localNodeId_ = localNodeId;
   localIP_ = localIP;
-  lastHeartbeatSent_ = std::chrono::steady_clock::now();
 }
 
 void HeartbeatManager::setSendCallback(HeartbeatSendCallback callback) {
@@ -28,13 +81,20 @@ void HeartbeatManager::setNodeExpiredCallback(NodeExpiredCallback callback) {
   expiredCallback_ = std::move(callback);
 }
 
+void HeartbeatManager::setGossipCallbacks(HeartbeatSendToCallback sendTo,
+                                          HeartbeatPeerListCallback peerList) {
+  sendToCallback_ = std::move(sendTo);
+  peerListCallback_ = std::move(peerList);
+}
+
+void HeartbeatManager::setTimerWheel(TimerWheel *timers) { timers_ = timers; }
+
 void HeartbeatManager::start() {
   if (running_) {
     return;
   }
   running_ = true;
-  heartbeatThread_ =
-      std::make_unique<std::thread>(&HeartbeatManager::heartbeatLoop, this);
+  scheduleHeartbeat();
   std::cout << "Heartbeat manager started" << std::endl;
 }
 
@@ -43,10 +103,16 @@ void HeartbeatManager::stop() {
     return;
   }
   running_ = false;
-  if (heartbeatThread_ && heartbeatThread_->joinable()) {
-    heartbeatThread_->join();
+  {
+    std::lock_guard<std::mutex> lock(nodeTableMutex_);
+    if (timers_) {
+      timers_->cancel(heartbeatTimer_);
+      timers_->cancel(probeTimer_);
+    }
+    heartbeatTimer_ = TimerWheel::kInvalidTimer;
+    probeTimer_ = TimerWheel::kInvalidTimer;
+    pendingRelays_.clear();
   }
-  heartbeatThread_.reset();
   std::cout << "Heartbeat manager stopped" << std::endl;
 }
 
@@ -54,32 +120,40 @@ void HeartbeatManager::reset() {
   stop();
   {
     std::lock_guard<std::mutex> lock(nodeTableMutex_);
+    cancelLeaseTimersLocked();
     nodeTable_.clear();
+    verifiedSources_.clear();
     ipToNodeId_.clear();
+    probeOrder_.clear();
+    probeCursor_ = 0;
+    gossipCursor_ = 0;
   }
   localIP_ = 0;
   localNodeId_.fill(0);
-  lastHeartbeatSent_ = std::chrono::steady_clock::now();
 }
 
 void HeartbeatManager::updateLocalIP(uint32_t ip) { localIP_ = ip; }
 
-void HeartbeatManager::heartbeatLoop() {
-  while (running_) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-    if (!running_) {
-      break;
-    }
-    const auto now = std::chrono::steady_clock::now();
-    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                             now - lastHeartbeatSent_)
-                             .count();
-    if (elapsed >= HEARTBEAT_INTERVAL_MS && localIP_ != 0) {
-      sendHeartbeat();
-      lastHeartbeatSent_ = now;
-    }
-    checkExpiredLeases();
+void HeartbeatManager::scheduleHeartbeat() {
+  std::lock_guard<std::mutex> lock(nodeTableMutex_);
+  if (!running_ || !timers_) {
+    return;
   }
+  const bool gossip = sendToCallback_ && peerListCallback_;
+  heartbeatTimer_ = timers_->schedule(
+      std::chrono::milliseconds(gossip ? GOSSIP_INTERVAL_MS
+                                       : HEARTBEAT_INTERVAL_MS),
+      [this, gossip]() {
+        if (!running_) {
+          return;
+        }
+        if (gossip) {
+          gossipRound();
+        } else {
+          sendHeartbeat();
+        }
+        scheduleHeartbeat();
+      });
 }
 
 void HeartbeatManager::sendHeartbeat() {
@@ -98,28 +172,230 @@ void HeartbeatManager::sendHeartbeat() {
                 true);
 }
 
-void HeartbeatManager::checkExpiredLeases() {
-  std::vector<std::pair<NodeID, uint32_t>> expiredNodes;
+void HeartbeatManager::gossipRound() {
+  if (localIP_ == 0) {
+    return;
+  }
+  const std::set<CSteamID> peers = peerListCallback_();
+  if (peers.empty()) {
+    return;
+  }
+  size_t fanout = 1;
+  for (size_t n = peers.size(); n > 1; n >>= 1) {
+    ++fanout;
+  }
+  fanout = std::min(fanout, peers.size());
+
+  std::vector<CSteamID> targets;
+  std::vector<uint8_t> message;
+  {
+    std::lock_guard<std::mutex> lock(nodeTableMutex_);
+    pendingRelays_.clear();
+    // Shuffled round-robin: every connected peer is heartbeated directly
+    // once per pass, which keeps older (broadcast-only) peers' leases alive
+    for (int pass = 0; pass < 2 && targets.size() < fanout; ++pass) {
+      while (probeCursor_ < probeOrder_.size() && targets.size() < fanout) {
+        const CSteamID peer = probeOrder_[probeCursor_++];
+        if (peers.count(peer) &&
+            std::find(targets.begin(), targets.end(), peer) == targets.end()) {
+          targets.push_back(peer);
+        }
+      }
+      if (targets.size() < fanout) {
+        probeOrder_.assign(peers.begin(), peers.end());
+        std::shuffle(probeOrder_.begin(), probeOrder_.end(), rng_);
+        probeCursor_ = 0;
+      }
+    }
+    message = buildGossipLocked(nullptr);
+  }
+
+  for (const CSteamID &target : targets) {
+    sendToCallback_(VpnMessageType::HEARTBEAT, message.data(), message.size(),
+                    target, true);
+  }
+
+  const CSteamID probe = targets.front();
+  const auto since = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(nodeTableMutex_);
+  if (running_ && timers_) {
+    timers_->cancel(probeTimer_);
+    probeTimer_ =
+        timers_->schedule(std::chrono::milliseconds(GOSSIP_ACK_TIMEOUT_MS),
+                          [this, probe, since]() {
+                            checkProbe(probe, since, false);
+                          });
+  }
+}
+
+std::vector<uint8_t>
+HeartbeatManager::buildGossipLocked(const NodeID *mustInclude) {
+  HeartbeatPayload payload;
+  payload.ipAddress = htonl(localIP_);
+  payload.nodeId = localNodeId_;
+  const auto now = std::chrono::steady_clock::now();
+  payload.timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            now.time_since_epoch())
+                            .count();
+
+  std::vector<GossipEntry> entries;
+  auto addEntry = [&](const NodeInfo &node) {
+    const int64_t age = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            now - node.lastHeartbeat)
+                            .count();
+    GossipEntry entry;
+    entry.steamId = node.steamId.ConvertToUint64();
+    entry.ipAddress = htonl(node.ipAddress);
+    entry.ageMs = static_cast<uint32_t>(std::clamp<int64_t>(
+        age, 0, std::numeric_limits<uint32_t>::max()));
+    entries.push_back(entry);
+  };
+  if (mustInclude) {
+    auto it = nodeTable_.find(*mustInclude);
+    if (it != nodeTable_.end() && !it->second.isLocal) {
+      addEntry(it->second);
+    }
+  }
+  // Rotate through the table so every node's freshness keeps circulating
+  if (!nodeTable_.empty()) {
+    auto it = nodeTable_.begin();
+    std::advance(it, gossipCursor_ % nodeTable_.size());
+    for (size_t visited = 0;
+         visited < nodeTable_.size() && entries.size() < MAX_GOSSIP_ENTRIES;
+         ++visited) {
+      const NodeInfo &node = it->second;
+      if (!node.isLocal && !node.suspect &&
+          (!mustInclude || node.nodeId != *mustInclude)) {
+        addEntry(node);
+      }
+      ++gossipCursor_;
+      if (++it == nodeTable_.end()) {
+        it = nodeTable_.begin();
+      }
+    }
+  }
+
+  GossipHeader header;
+  header.flags = 0;
+  header.count = static_cast<uint8_t>(entries.size());
+  std::vector<uint8_t> message(sizeof(payload) + sizeof(header) +
+                               entries.size() * sizeof(GossipEntry));
+  std::memcpy(message.data(), &payload, sizeof(payload));
+  std::memcpy(message.data() + sizeof(payload), &header, sizeof(header));
+  if (!entries.empty()) {
+    std::memcpy(message.data() + sizeof(payload) + sizeof(header),
+                entries.data(), entries.size() * sizeof(GossipEntry));
+  }
+  return message;
+}
+
+void HeartbeatManager::checkProbe(CSteamID target,
+                                  std::chrono::steady_clock::time_point since,
+                                  bool indirect) {
+  std::vector<CSteamID> helpers;
   {
     std::lock_guard<std::mutex> lock(nodeTableMutex_);
-    for (auto it = nodeTable_.begin(); it != nodeTable_.end();) {
-      if (!it->second.isLocal && it->second.isLeaseExpired()) {
+    probeTimer_ = TimerWheel::kInvalidTimer;
+    if (!running_) {
+      return;
+    }
+    // Targets without a node entry (not negotiated yet) have no lease to
+    // vouch for
+    auto it = nodeTable_.find(NodeIdentity::generate(target));
+    if (it == nodeTable_.end()) {
+      return;
+    }
+    if (it->second.lastHeartbeat >= since) {
+      it->second.suspect = false;
+      return;
+    }
+    if (indirect) {
+      if (!it->second.suspect) {
+        it->second.suspect = true;
         std::cout << "Node " << NodeIdentity::toString(it->first)
-                  << " lease expired" << std::endl;
-        expiredNodes.emplace_back(it->first, it->second.ipAddress);
-        ipToNodeId_.erase(it->second.ipAddress);
-        it = nodeTable_.erase(it);
-      } else {
-        ++it;
+                  << " suspected: no direct or indirect heartbeat ack"
+                  << std::endl;
       }
+      return;
     }
   }
 
-  if (expiredCallback_) {
-    for (const auto &[nodeId, ip] : expiredNodes) {
-      expiredCallback_(nodeId, ip);
+  for (const CSteamID &peer : peerListCallback_()) {
+    if (peer != target) {
+      helpers.push_back(peer);
     }
   }
+  {
+    std::lock_guard<std::mutex> lock(nodeTableMutex_);
+    std::shuffle(helpers.begin(), helpers.end(), rng_);
+  }
+  if (helpers.size() > GOSSIP_INDIRECT_PROBES) {
+    helpers.resize(GOSSIP_INDIRECT_PROBES);
+  }
+  HeartbeatPingReqPayload request;
+  request.targetSteamId = target.ConvertToUint64();
+  for (const CSteamID &helper : helpers) {
+    sendToCallback_(VpnMessageType::HEARTBEAT_PING_REQ,
+                    reinterpret_cast<const uint8_t *>(&request),
+                    sizeof(request), helper, true);
+  }
+
+  std::lock_guard<std::mutex> lock(nodeTableMutex_);
+  if (running_ && timers_) {
+    probeTimer_ = timers_->schedule(
+        std::chrono::milliseconds(GOSSIP_ACK_TIMEOUT_MS),
+        [this, target, since]() { checkProbe(target, since, true); });
+  }
+}
+
+void HeartbeatManager::armLeaseTimerLocked(const NodeID &nodeId,
+                                           int64_t delayMs) {
+  if (!timers_) {
+    return;
+  }
+  leaseTimers_[nodeId] = timers_->schedule(
+      std::chrono::milliseconds(delayMs),
+      [this, nodeId]() { onLeaseTimer(nodeId); });
+}
+
+void HeartbeatManager::cancelLeaseTimersLocked() {
+  if (timers_) {
+    for (const auto &[nodeId, timer] : leaseTimers_) {
+      timers_->cancel(timer);
+    }
+  }
+  leaseTimers_.clear();
+}
+
+void HeartbeatManager::onLeaseTimer(const NodeID &nodeId) {
+  uint32_t expiredIP = 0;
+  {
+    std::lock_guard<std::mutex> lock(nodeTableMutex_);
+    auto it = nodeTable_.find(nodeId);
+    if (it == nodeTable_.end() || it->second.isLocal) {
+      leaseTimers_.erase(nodeId);
+      return;
+    }
+    if (!it->second.isLeaseExpired()) {
+      const auto elapsed =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - it->second.lastHeartbeat)
+              .count();
+      armLeaseTimerLocked(nodeId, LEASE_EXPIRY_MS - elapsed);
+      return;
+    }
+    std::cout << "Node " << NodeIdentity::toString(nodeId) << " lease expired"
+              << std::endl;
+    expiredIP = it->second.ipAddress;
+    verifiedSources_.clear();
+    ipToNodeId_.erase(expiredIP);
+    nodeTable_.erase(it);
+    leaseTimers_.erase(nodeId);
+  }
+
+  if (expiredCallback_) {
+    expiredCallback_(nodeId, expiredIP);
+  }
 }
 
 void HeartbeatManager::handleHeartbeat(const HeartbeatPayload &heartbeat,
@@ -139,10 +415,115 @@ void HeartbeatManager::handleHeartbeat(const HeartbeatPayload &heartbeat,
     nodeInfo.name = peerName;
     nodeInfo.isLocal = false;
     nodeTable_[heartbeat.nodeId] = nodeInfo;
+    verifiedSources_.clear();
     ipToNodeId_[heartbeatIP] = heartbeat.nodeId;
+    armLeaseTimerLocked(heartbeat.nodeId, LEASE_EXPIRY_MS);
   }
 }
 
+void HeartbeatManager::handleGossip(const uint8_t *gossip, size_t length,
+                                    CSteamID peerSteamID, bool isAck) {
+  if (length < sizeof(GossipHeader)) {
+    return;
+  }
+  GossipHeader header;
+  std::memcpy(&header, gossip, sizeof(header));
+  const size_t count =
+      std::min<size_t>(header.count, (length - sizeof(header)) /
+                                         sizeof(GossipEntry));
+  const auto now = std::chrono::steady_clock::now();
+
+  std::vector<uint8_t> reply;
+  std::vector<CSteamID> relayTo;
+  {
+    std::lock_guard<std::mutex> lock(nodeTableMutex_);
+    for (size_t i = 0; i < count; ++i) {
+      GossipEntry entry;
+      std::memcpy(&entry, gossip + sizeof(header) + i * sizeof(entry),
+                  sizeof(entry));
+      if (entry.ageMs >= LEASE_EXPIRY_MS) {
+        continue;
+      }
+      const CSteamID steamId(static_cast<uint64>(entry.steamId));
+      const NodeID nodeId = NodeIdentity::generate(steamId);
+      if (nodeId == localNodeId_) {
+        continue;
+      }
+      const auto heardAt = now - std::chrono::milliseconds(entry.ageMs);
+      auto it = nodeTable_.find(nodeId);
+      if (it != nodeTable_.end()) {
+        if (!it->second.isLocal && heardAt > it->second.lastHeartbeat) {
+          it->second.lastHeartbeat = heardAt;
+          it->second.suspect = false;
+        }
+        continue;
+      }
+      // Hearsay never rebinds an address another node already holds
+      const uint32_t ip = ntohl(entry.ipAddress);
+      if (ip == 0 || ipToNodeId_.find(ip) != ipToNodeId_.end()) {
+        continue;
+      }
+      NodeInfo nodeInfo;
+      nodeInfo.nodeId = nodeId;
+      nodeInfo.steamId = steamId;
+      nodeInfo.ipAddress = ip;
+      nodeInfo.lastHeartbeat = heardAt;
+      nodeInfo.isLocal = false;
+      nodeTable_[nodeId] = nodeInfo;
+      verifiedSources_.clear();
+      ipToNodeId_[ip] = nodeId;
+      armLeaseTimerLocked(nodeId, LEASE_EXPIRY_MS - entry.ageMs);
+    }
+
+    if (localIP_ == 0) {
+      return;
+    }
+    if (!isAck) {
+      reply = buildGossipLocked(nullptr);
+    } else {
+      auto relayIt = pendingRelays_.find(peerSteamID);
+      if (relayIt != pendingRelays_.end()) {
+        const NodeID peerNodeId = NodeIdentity::generate(peerSteamID);
+        reply = buildGossipLocked(&peerNodeId);
+        relayTo = std::move(relayIt->second);
+        pendingRelays_.erase(relayIt);
+      }
+    }
+  }
+
+  if (!sendToCallback_ || reply.empty()) {
+    return;
+  }
+  if (!isAck) {
+    relayTo.push_back(peerSteamID);
+  }
+  for (const CSteamID &target : relayTo) {
+    sendToCallback_(VpnMessageType::HEARTBEAT_ACK, reply.data(), reply.size(),
+                    target, true);
+  }
+}
+
+void HeartbeatManager::handlePingRequest(const HeartbeatPingReqPayload &request,
+                                         CSteamID requesterSteamID) {
+  const CSteamID target(static_cast<uint64>(request.targetSteamId));
+  if (!sendToCallback_ || localIP_ == 0 || target == requesterSteamID) {
+    return;
+  }
+  std::vector<uint8_t> message;
+  {
+    std::lock_guard<std::mutex> lock(nodeTableMutex_);
+    auto &requesters = pendingRelays_[target];
+    if (std::find(requesters.begin(), requesters.end(), requesterSteamID) ==
+            requesters.end() &&
+        requesters.size() < kMaxRelayRequesters) {
+      requesters.push_back(requesterSteamID);
+    }
+    message = buildGossipLocked(nullptr);
+  }
+  sendToCallback_(VpnMessageType::HEARTBEAT, message.data(), message.size(),
+                  target, true);
+}
+
 void HeartbeatManager::registerNode(const NodeID &nodeId, CSteamID steamId,
                                     uint32_t ipAddress,
                                     const std::string &name) {
@@ -155,16 +536,28 @@ void HeartbeatManager::registerNode(const NodeID &nodeId, CSteamID steamId,
   nodeInfo.name = name;
   nodeInfo.isLocal = (nodeId == localNodeId_);
   nodeTable_[nodeId] = nodeInfo;
+  verifiedSources_.clear();
   ipToNodeId_[ipAddress] = nodeId;
+  if (!nodeInfo.isLocal && leaseTimers_.find(nodeId) == leaseTimers_.end()) {
+    armLeaseTimerLocked(nodeId, LEASE_EXPIRY_MS);
+  }
 }
 
 void HeartbeatManager::unregisterNode(const NodeID &nodeId) {
   std::lock_guard<std::mutex> lock(nodeTableMutex_);
   auto it = nodeTable_.find(nodeId);
   if (it != nodeTable_.end()) {
+    verifiedSources_.clear();
     ipToNodeId_.erase(it->second.ipAddress);
     nodeTable_.erase(it);
   }
+  auto timerIt = leaseTimers_.find(nodeId);
+  if (timerIt != leaseTimers_.end()) {
+    if (timers_) {
+      timers_->cancel(timerIt->second);
+    }
+    leaseTimers_.erase(timerIt);
+  }
 }
 
 bool HeartbeatManager::findNodeByIP(uint32_t ip, NodeID &outNodeId) const {
@@ -184,10 +577,21 @@ std::map<NodeID, NodeInfo> HeartbeatManager::getAllNodes() const {
 
 bool HeartbeatManager::detectConflict(uint32_t sourceIP,
                                       const NodeID &senderNodeId,
+                                      CSteamID senderSteamID,
                                       CSteamID &outConflictingSteamID) {
+  const uint32_t accountId = senderSteamID.GetAccountID();
+  if (verifiedSources_.contains(accountId, sourceIP)) {
+    return false;
+  }
+
   std::lock_guard<std::mutex> lock(nodeTableMutex_);
   auto it = ipToNodeId_.find(sourceIP);
-  if (it != ipToNodeId_.end() && it->second != senderNodeId) {
+  if (it != ipToNodeId_.end() && it->second == senderNodeId) {
+    // Binding confirmed; later packets from this peer skip the lock
+    verifiedSources_.insert(accountId, sourceIP);
+    return false;
+  }
+  if (it != ipToNodeId_.end()) {
     std::cout << "Packet-level conflict detected for IP" << std::endl;
     if (NodeIdentity::hasPriority(it->second, senderNodeId)) {
       auto nodeIt = nodeTable_.find(senderNodeId);
@@ -199,6 +603,7 @@ bool HeartbeatManager::detectConflict(uint32_t sourceIP,
       auto nodeIt = nodeTable_.find(it->second);
       if (nodeIt != nodeTable_.end()) {
         outConflictingSteamID = nodeIt->second.steamId;
+        verifiedSources_.clear();
         it->second = senderNodeId;
         return true;
       }
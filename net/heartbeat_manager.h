@@ -1,21 +1,56 @@
 #pragma once
 
 #include "node_identity.h"
+#include "timer_wheel.h"
 #include "vpn_protocol.h"
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <functional>
 #include <map>
 #include <mutex>
+#include <random>
+#include <set>
 #include <steam_api.h>
-#include <thread>
+#include <vector>
 
 using HeartbeatSendCallback =
     std::function<void(VpnMessageType type, const uint8_t *payload,
                        size_t length, bool reliable)>;
+using HeartbeatSendToCallback =
+    std::function<void(VpnMessageType type, const uint8_t *payload,
+                       size_t length, CSteamID target, bool reliable)>;
+using HeartbeatPeerListCallback = std::function<std::set<CSteamID>()>;
 using NodeExpiredCallback =
     std::function<void(const NodeID &nodeId, uint32_t ipAddress)>;
 
+// (Steam account, source IP) bindings already arbitrated by detectConflict.
+// Readers probe it without locking; inserts and clears are serialized by the
+// caller, so a clear can only make a reader miss and take the slow path.
+class VerifiedSourceTable {
+public:
+  bool contains(uint32_t accountId, uint32_t ip) const;
+  void insert(uint32_t accountId, uint32_t ip);
+  void clear();
+
+private:
+  static constexpr int kSlotBits = 10;
+  static constexpr std::size_t kSlots = std::size_t(1) << kSlotBits;
+  // Past half full new bindings simply stay on the slow path
+  static constexpr std::size_t kMaxEntries = kSlots / 2;
+
+  static uint64_t keyFor(uint32_t accountId, uint32_t ip) {
+    return (static_cast<uint64_t>(accountId) << 32) | ip;
+  }
+  static std::size_t slotFor(uint64_t key) {
+    return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ULL) >>
+                                    (64 - kSlotBits));
+  }
+
+  std::array<std::atomic<uint64_t>, kSlots> slots_{};
+  std::size_t size_ = 0;
+};
+
 class HeartbeatManager {
 public:
   HeartbeatManager();
@@ -24,6 +59,13 @@ public:
   void initialize(const NodeID &localNodeId, uint32_t localIP);
   void setSendCallback(HeartbeatSendCallback callback);
   void setNodeExpiredCallback(NodeExpiredCallback callback);
+  // With both set, heartbeats are gossiped to a few connected peers per
+  // round instead of broadcast to all of them.
+  void setGossipCallbacks(HeartbeatSendToCallback sendTo,
+                          HeartbeatPeerListCallback peerList);
+  // Heartbeats and lease expiry run as timers on `timers`, which must outlive
+  // this manager's start()/reset() cycle. Call before start().
+  void setTimerWheel(TimerWheel *timers);
   void start();
   void stop();
   void reset();
@@ -31,30 +73,64 @@ public:
 
   void handleHeartbeat(const HeartbeatPayload &heartbeat,
                        CSteamID peerSteamID, const std::string &peerName);
+  // `gossip` is whatever followed HeartbeatPayload in a HEARTBEAT (isAck
+  // false, answered with an ack) or a HEARTBEAT_ACK.
+  void handleGossip(const uint8_t *gossip, size_t length, CSteamID peerSteamID,
+                    bool isAck);
+  void handlePingRequest(const HeartbeatPingReqPayload &request,
+                         CSteamID requesterSteamID);
   void registerNode(const NodeID &nodeId, CSteamID steamId, uint32_t ipAddress,
                     const std::string &name);
   void unregisterNode(const NodeID &nodeId);
   bool findNodeByIP(uint32_t ip, NodeID &outNodeId) const;
   std::map<NodeID, NodeInfo> getAllNodes() const;
+  // Per-packet check. A (sender, sourceIP) pair confirmed once is answered
+  // from a lock-free table until the node mappings change.
   bool detectConflict(uint32_t sourceIP, const NodeID &senderNodeId,
-                      CSteamID &outConflictingSteamID);
+                      CSteamID senderSteamID, CSteamID &outConflictingSteamID);
 
 private:
-  void heartbeatLoop();
+  void scheduleHeartbeat();
   void sendHeartbeat();
-  void checkExpiredLeases();
+  void gossipRound();
+  // Own HeartbeatPayload plus up to MAX_GOSSIP_ENTRIES remote nodes, taken
+  // round-robin from the node table; `mustInclude` (a relayed ack) first.
+  std::vector<uint8_t> buildGossipLocked(const NodeID *mustInclude);
+  void checkProbe(CSteamID target, std::chrono::steady_clock::time_point since,
+                  bool indirect);
+  // Each remote node carries one lease timer. Heartbeats only refresh
+  // lastHeartbeat; a firing timer re-arms itself for whatever is left.
+  void armLeaseTimerLocked(const NodeID &nodeId, int64_t delayMs);
+  void cancelLeaseTimersLocked();
+  void onLeaseTimer(const NodeID &nodeId);
 
   NodeID localNodeId_;
   uint32_t localIP_;
-  std::chrono::steady_clock::time_point lastHeartbeatSent_;
 
   std::map<NodeID, NodeInfo> nodeTable_;
   std::map<uint32_t, NodeID> ipToNodeId_;
   mutable std::mutex nodeTableMutex_;
+  // Cleared (under nodeTableMutex_) before any change to ipToNodeId_, so the
+  // lock-free check in detectConflict never vouches for a stale binding
+  VerifiedSourceTable verifiedSources_;
 
-  std::unique_ptr<std::thread> heartbeatThread_;
+  TimerWheel *timers_ = nullptr;
+  // Both guarded by nodeTableMutex_
+  TimerWheel::TimerId heartbeatTimer_ = TimerWheel::kInvalidTimer;
+  std::map<NodeID, TimerWheel::TimerId> leaseTimers_;
   std::atomic<bool> running_;
 
+  // Gossip state, guarded by nodeTableMutex_
+  std::vector<CSteamID> probeOrder_;
+  size_t probeCursor_ = 0;
+  size_t gossipCursor_ = 0;
+  std::map<CSteamID, std::vector<CSteamID>> pendingRelays_;
+  // One probe is in flight at a time; rounds outlast both of its timeouts
+  TimerWheel::TimerId probeTimer_ = TimerWheel::kInvalidTimer;
+  std::mt19937 rng_;
+
   HeartbeatSendCallback sendCallback_;
+  HeartbeatSendToCallback sendToCallback_;
+  HeartbeatPeerListCallback peerListCallback_;
   NodeExpiredCallback expiredCallback_;
 };
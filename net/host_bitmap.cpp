@@ -0,0 +1,156 @@
+#include "host_bitmap.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+// Index of the lowest set bit; `value` must be non-zero
+inline int lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+inline uint64_t bitsFrom(int bit) { return ~uint64_t(0) << bit; }
+} // namespace
+
+HostBitmap::HostBitmap(uint32_t hostCount) { reset(hostCount); }
+
+void HostBitmap::reset(uint32_t hostCount) {
+  hostCount_ = hostCount < kMaxHosts ? hostCount : kMaxHosts;
+  const uint32_t pageCount = (hostCount_ + kPageHosts - 1) >> kPageBits;
+  pages_.clear();
+  pages_.resize(pageCount);
+  fullPages_.assign((pageCount + kWordBits - 1) / kWordBits, 0);
+  if (hostCount_ == 0) {
+    return;
+  }
+  // Bits past the end of a partial last page read as used, so the scan
+  // never has to bounds-check inside a page
+  for (uint32_t host = pageCount * kPageHosts; host-- > hostCount_;) {
+    set(host);
+  }
+  set(0);
+  set(hostCount_ - 1);
+}
+
+void HostBitmap::set(uint32_t host) {
+  if (host >= pages_.size() * kPageHosts) {
+    return;
+  }
+  const uint32_t pageIndex = host >> kPageBits;
+  auto &page = pages_[pageIndex];
+  if (!page) {
+    page = std::make_unique<Page>();
+  }
+  const uint32_t word = (host >> 6) & (kPageWords - 1);
+  const uint64_t bit = uint64_t(1) << (host & 63);
+  if (page->words[word] & bit) {
+    return;
+  }
+  page->words[word] |= bit;
+  ++page->used;
+  if (page->words[word] == ~uint64_t(0)) {
+    page->fullWords |= uint64_t(1) << word;
+    if (page->fullWords == ~uint64_t(0)) {
+      fullPages_[pageIndex / kWordBits] |= uint64_t(1)
+                                           << (pageIndex % kWordBits);
+    }
+  }
+}
+
+void HostBitmap::clear(uint32_t host) {
+  // The reserved hosts stay used
+  if (host == 0 || host + 1 >= hostCount_) {
+    return;
+  }
+  const uint32_t pageIndex = host >> kPageBits;
+  auto &page = pages_[pageIndex];
+  if (!page) {
+    return;
+  }
+  const uint32_t word = (host >> 6) & (kPageWords - 1);
+  const uint64_t bit = uint64_t(1) << (host & 63);
+  if (!(page->words[word] & bit)) {
+    return;
+  }
+  page->words[word] &= ~bit;
+  page->fullWords &= ~(uint64_t(1) << word);
+  fullPages_[pageIndex / kWordBits] &=
+      ~(uint64_t(1) << (pageIndex % kWordBits));
+  if (--page->used == 0) {
+    page.reset();
+  }
+}
+
+bool HostBitmap::test(uint32_t host) const {
+  if (host >= pages_.size() * kPageHosts) {
+    return true;
+  }
+  const auto &page = pages_[host >> kPageBits];
+  return page &&
+         (page->words[(host >> 6) & (kPageWords - 1)] >> (host & 63)) & 1;
+}
+
+bool HostBitmap::findFree(uint32_t start, uint32_t &outHost) const {
+  if (start >= hostCount_) {
+    start = 0;
+  }
+  return findFreeInRange(start, hostCount_, outHost) ||
+         findFreeInRange(0, start, outHost);
+}
+
+bool HostBitmap::findFreeInRange(uint32_t from, uint32_t end,
+                                 uint32_t &outHost) const {
+  while (from < end) {
+    const uint32_t pageIndex = from >> kPageBits;
+    const Page *page = pages_[pageIndex].get();
+    if (!page) {
+      outHost = from;
+      return true;
+    }
+    if (!(fullPages_[pageIndex / kWordBits] >> (pageIndex % kWordBits) & 1)) {
+      const uint32_t pageBase = pageIndex << kPageBits;
+      uint32_t word = (from >> 6) & (kPageWords - 1);
+      const uint64_t free = ~page->words[word] & bitsFrom(from & 63);
+      if (free) {
+        outHost = pageBase + word * kWordBits + lowestBit(free);
+        return outHost < end;
+      }
+      const uint64_t openWords =
+          word + 1 < kPageWords ? ~page->fullWords & bitsFrom(word + 1) : 0;
+      if (openWords) {
+        word = lowestBit(openWords);
+        outHost = pageBase + word * kWordBits + lowestBit(~page->words[word]);
+        return outHost < end;
+      }
+    }
+    uint32_t nextPage;
+    if (!nextOpenPage(pageIndex + 1, (end + kPageHosts - 1) >> kPageBits,
+                      nextPage)) {
+      return false;
+    }
+    from = nextPage << kPageBits;
+  }
+  return false;
+}
+
+bool HostBitmap::nextOpenPage(uint32_t from, uint32_t end,
+                              uint32_t &outPage) const {
+  while (from < end) {
+    const uint32_t wordIndex = from / kWordBits;
+    const uint64_t open =
+        ~fullPages_[wordIndex] & bitsFrom(static_cast<int>(from % kWordBits));
+    if (open) {
+      outPage = wordIndex * kWordBits + lowestBit(open);
+      return outPage < end;
+    }
+    from = (wordIndex + 1) * kWordBits;
+  }
+  return false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Used/free map over the host part of a subnet. Leaf bits live in 4096-host
+// pages allocated on first use and freed again once empty, so a sparse /8
+// costs a few KB. Every page keeps a "word is full" summary and a top-level
+// bitmap records full pages, letting findFree() skip dense ranges a word or a
+// page at a time instead of one host at a time.
+class HostBitmap {
+public:
+  // Host numbers at or above this are never tracked (see IpNegotiator,
+  // whose candidates never exceed it).
+  static constexpr uint32_t kMaxHosts = 1u << 24;
+
+  explicit HostBitmap(uint32_t hostCount = 0);
+
+  // Frees every host; host 0 (network) and hostCount - 1 (broadcast) are
+  // reserved and always read as used.
+  void reset(uint32_t hostCount);
+  void set(uint32_t host);
+  void clear(uint32_t host);
+  bool test(uint32_t host) const;
+  // First free host at or after `start`, wrapping once around the range.
+  bool findFree(uint32_t start, uint32_t &outHost) const;
+  uint32_t hostCount() const { return hostCount_; }
+
+private:
+  static constexpr int kWordBits = 64;
+  static constexpr int kPageWordBits = 6;
+  static constexpr uint32_t kPageWords = 1u << kPageWordBits;
+  static constexpr int kPageBits = kPageWordBits + 6;
+  static constexpr uint32_t kPageHosts = 1u << kPageBits;
+
+  struct Page {
+    std::array<uint64_t, kPageWords> words{};
+    uint64_t fullWords = 0; // bit w: words[w] == ~0
+    uint32_t used = 0;
+  };
+
+  bool findFreeInRange(uint32_t from, uint32_t end, uint32_t &outHost) const;
+  bool nextOpenPage(uint32_t from, uint32_t end, uint32_t &outPage) const;
+
+  uint32_t hostCount_ = 0;
+  std::vector<std::unique_ptr<Page>> pages_;
+  std::vector<uint64_t> fullPages_; // bit p: every host of page p is used
+};
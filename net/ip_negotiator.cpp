@@ -1,4 +1,5 @@
 #include "ip_negotiator.h"
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
@@ -19,19 +20,33 @@ void IpNegotiator::initialize(CSteamID localSteamID, uint32_t baseIP,
   localSteamID_ = localSteamID;
   baseIP_ = baseIP;
   subnetMask_ = subnetMask;
+  {
+    std::lock_guard<std::mutex> lock(usedIPsMutex_);
+    usedHosts_.reset(hostCount());
+  }
   localNodeId_ = NodeIdentity::generate(localSteamID);
   std::cout << "Generated Node ID: " << NodeIdentity::toString(localNodeId_)
             << std::endl;
 }
 
+void IpNegotiator::setTimerWheel(TimerWheel *timers) { timers_ = timers; }
+
 void IpNegotiator::reset() {
+  if (timers_) {
+    timers_->cancel(probeTimer_.exchange(TimerWheel::kInvalidTimer));
+  }
   {
     std::lock_guard<std::mutex> lock(usedIPsMutex_);
-    usedIPs_.clear();
+    usedHosts_.reset(hostCount());
   }
   {
-    std::lock_guard<std::mutex> lock(conflictsMutex_);
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    candidates_.clear();
+    awaitingAcks_.clear();
     collectedConflicts_.clear();
+    probeRoundIP_ = 0;
+    probeResolved_ = false;
+    resumePending_ = false;
   }
   state_ = NegotiationState::IDLE;
   candidateIP_ = 0;
@@ -49,23 +64,116 @@ void IpNegotiator::setSuccessCallback(NegotiationSuccessCallback callback) {
   successCallback_ = std::move(callback);
 }
 
+void IpNegotiator::setPeerListCallback(VpnPeerListCallback callback) {
+  peerListCallback_ = std::move(callback);
+}
+
 void IpNegotiator::startNegotiation() {
+  std::set<CSteamID> peers;
+  if (peerListCallback_) {
+    peers = peerListCallback_();
+  }
+  const std::vector<uint32_t> candidates = pickCandidates();
   {
-    std::lock_guard<std::mutex> lock(conflictsMutex_);
+    std::lock_guard<std::mutex> lock(probeMutex_);
     collectedConflicts_.clear();
+    candidates_ = candidates;
+    candidateIP_ = candidates.front();
+    probeRoundIP_ = candidates.front();
+    probeResolved_ = false;
+    resumePending_ = false;
+    awaitingAcks_ = std::move(peers);
+    probeStartTime_ = std::chrono::steady_clock::now();
+    state_ = NegotiationState::PROBING;
   }
 
-  candidateIP_ = generateCandidateIP(probeOffset_);
-  candidateIP_ = findNextAvailableIP(candidateIP_);
-  state_ = NegotiationState::PROBING;
-
-  std::cout << "Probing IP: " << ((candidateIP_ >> 24) & 0xFF) << "."
+  std::cout << "Probing " << candidates.size() << " IPs from "
+            << ((candidateIP_ >> 24) & 0xFF) << "."
             << ((candidateIP_ >> 16) & 0xFF) << "."
             << ((candidateIP_ >> 8) & 0xFF) << "." << (candidateIP_ & 0xFF)
             << " (offset=" << probeOffset_ << ")" << std::endl;
 
-  sendProbeRequest();
-  probeStartTime_ = std::chrono::steady_clock::now();
+  sendProbeRequest(candidates);
+  if (timers_) {
+    // A superseded timer that already fired is harmless: checkTimeout()
+    // re-checks the elapsed time against the new probe.
+    const TimerWheel::TimerId timer =
+        timers_->schedule(std::chrono::milliseconds(PROBE_TIMEOUT_MS),
+                          [this]() { checkTimeout(); });
+    timers_->cancel(probeTimer_.exchange(timer));
+  }
+
+  // No peers to wait for (or every ack already came back): decide now
+  bool allAnswered;
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    allAnswered = awaitingAcks_.empty();
+  }
+  if (allAnswered) {
+    resolveProbe();
+  }
+}
+
+bool IpNegotiator::resumeLease(uint32_t ip) {
+  const uint32_t hostPart = ip & ~subnetMask_;
+  if ((ip & subnetMask_) != (baseIP_ & subnetMask_) || hostPart == 0 ||
+      hostPart == ~subnetMask_ || state_ != NegotiationState::IDLE) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    candidates_.clear();
+    awaitingAcks_.clear();
+    collectedConflicts_.clear();
+    probeResolved_ = true;
+    resumePending_ = true;
+    resumedAt_ = std::chrono::steady_clock::now();
+    candidateIP_ = ip;
+    localIP_ = ip;
+    state_ = NegotiationState::STABLE;
+  }
+
+  std::cout << "Resuming cached lease: " << ((ip >> 24) & 0xFF) << "."
+            << ((ip >> 16) & 0xFF) << "." << ((ip >> 8) & 0xFF) << "."
+            << (ip & 0xFF) << std::endl;
+  sendAddressAnnounce();
+  if (successCallback_) {
+    successCallback_(localIP_, localNodeId_);
+  }
+  return true;
+}
+
+std::vector<uint32_t> IpNegotiator::pickCandidates() {
+  std::vector<uint32_t> candidates;
+  for (uint32_t k = 0; candidates.size() < MAX_PROBE_CANDIDATES &&
+                       k < 2 * MAX_PROBE_CANDIDATES;
+       ++k) {
+    const uint32_t ip =
+        findNextAvailableIP(generateCandidateIP(probeOffset_ + k));
+    if (std::find(candidates.begin(), candidates.end(), ip) ==
+        candidates.end()) {
+      candidates.push_back(ip);
+    }
+  }
+  return candidates;
+}
+
+bool IpNegotiator::dropCandidateLocked(uint32_t ip) {
+  candidates_.erase(std::remove(candidates_.begin(), candidates_.end(), ip),
+                    candidates_.end());
+  if (!candidates_.empty() && candidateIP_ == ip) {
+    candidateIP_ = candidates_.front();
+  }
+  return candidates_.empty();
+}
+
+bool IpNegotiator::resumePendingLocked() {
+  if (resumePending_ &&
+      std::chrono::steady_clock::now() - resumedAt_ >=
+          std::chrono::milliseconds(PROBE_TIMEOUT_MS)) {
+    resumePending_ = false;
+  }
+  return resumePending_;
 }
 
 uint32_t IpNegotiator::generateCandidateIP(uint32_t offset) {
@@ -87,159 +195,209 @@ uint32_t IpNegotiator::generateCandidateIP(uint32_t offset) {
   return ip;
 }
 
+uint32_t IpNegotiator::hostCount() const {
+  // Candidates never exceed 24 host bits (see generateCandidateIP)
+  const uint64_t hosts = static_cast<uint64_t>(~subnetMask_) + 1;
+  return hosts < HostBitmap::kMaxHosts ? static_cast<uint32_t>(hosts)
+                                       : HostBitmap::kMaxHosts;
+}
+
 uint32_t IpNegotiator::findNextAvailableIP(uint32_t startIP) {
   std::lock_guard<std::mutex> lock(usedIPsMutex_);
-
-  const uint32_t hostMask = ~subnetMask_;
-  uint32_t maxHosts = hostMask - 1;
-  if (maxHosts == 0) {
-    maxHosts = 1;
+  uint32_t hostPart = startIP & ~subnetMask_;
+  if (!usedHosts_.findFree(hostPart, hostPart)) {
+    // Subnet full: probe the hashed candidate and let arbitration decide
+    return startIP;
   }
-
-  uint32_t hostPart = startIP & hostMask;
-  if (hostPart == 0 || hostPart >= hostMask) {
-    hostPart = 1;
-  }
-
-  uint32_t potentialIP = (baseIP_ & subnetMask_) | hostPart;
-  uint32_t attempts = 0;
-  while (usedIPs_.count(potentialIP) && attempts < maxHosts) {
-    hostPart++;
-    if (hostPart >= hostMask) {
-      hostPart = 1;
-    }
-    potentialIP = (baseIP_ & subnetMask_) | hostPart;
-    attempts++;
-  }
-  return potentialIP;
+  return (baseIP_ & subnetMask_) | hostPart;
 }
 
-void IpNegotiator::sendProbeRequest() {
+void IpNegotiator::sendProbeRequest(const std::vector<uint32_t> &candidates) {
   if (!broadcastCallback_) {
     return;
   }
+  std::vector<uint8_t> buffer(sizeof(ProbeRequestPayload) +
+                              (candidates.size() - 1) * sizeof(uint32_t));
   ProbeRequestPayload payload;
-  payload.ipAddress = htonl(candidateIP_);
+  payload.ipAddress = htonl(candidates.front());
   payload.nodeId = localNodeId_;
+  std::memcpy(buffer.data(), &payload, sizeof(payload));
+  for (size_t i = 1; i < candidates.size(); ++i) {
+    const uint32_t ip = htonl(candidates[i]);
+    std::memcpy(buffer.data() + sizeof(payload) + (i - 1) * sizeof(ip), &ip,
+                sizeof(ip));
+  }
 
-  broadcastCallback_(VpnMessageType::PROBE_REQUEST,
-                     reinterpret_cast<const uint8_t *>(&payload),
-                     sizeof(payload), true);
+  broadcastCallback_(VpnMessageType::PROBE_REQUEST, buffer.data(),
+                     buffer.size(), true);
+}
+
+void IpNegotiator::sendProbeAck(uint32_t probeIP, CSteamID targetSteamID) {
+  if (!sendCallback_) {
+    return;
+  }
+  ProbeAckPayload payload;
+  payload.ipAddress = htonl(probeIP);
+  payload.nodeId = localNodeId_;
+  sendCallback_(VpnMessageType::PROBE_ACK,
+                reinterpret_cast<const uint8_t *>(&payload), sizeof(payload),
+                targetSteamID, true);
 }
 
 void IpNegotiator::checkTimeout() {
   if (state_ != NegotiationState::PROBING) {
     return;
   }
-  const auto now = std::chrono::steady_clock::now();
-  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                           now - probeStartTime_)
-                           .count();
-  if (elapsed < PROBE_TIMEOUT_MS) {
-    return;
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - probeStartTime_)
+                             .count();
+    if (elapsed < PROBE_TIMEOUT_MS) {
+      return;
+    }
   }
+  resolveProbe();
+}
 
+void IpNegotiator::resolveProbe() {
   std::vector<ConflictInfo> conflicts;
+  std::vector<uint32_t> candidates;
   {
-    std::lock_guard<std::mutex> lock(conflictsMutex_);
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    if (state_ != NegotiationState::PROBING || probeResolved_) {
+      return;
+    }
+    probeResolved_ = true;
     conflicts = std::move(collectedConflicts_);
     collectedConflicts_.clear();
+    candidates = candidates_;
   }
 
-  bool canClaim = true;
-  std::vector<CSteamID> nodesToForceRelease;
-
-  for (const auto &conflict : conflicts) {
-    const auto currentMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-                               now.time_since_epoch())
-                               .count();
-    const int64_t heartbeatAge = currentMs - conflict.lastHeartbeatMs;
-    if (heartbeatAge >= HEARTBEAT_EXPIRY_MS) {
-      std::cout << "Ignoring stale node (heartbeat age: " << heartbeatAge
-                << "ms)" << std::endl;
-      continue;
+  const auto now = std::chrono::steady_clock::now();
+  const auto currentMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             now.time_since_epoch())
+                             .count();
+  for (const uint32_t candidate : candidates) {
+    bool canClaim = true;
+    std::vector<CSteamID> nodesToForceRelease;
+
+    for (const auto &conflict : conflicts) {
+      if (conflict.ipAddress != candidate) {
+        continue;
+      }
+      const int64_t heartbeatAge = currentMs - conflict.lastHeartbeatMs;
+      if (heartbeatAge >= HEARTBEAT_EXPIRY_MS) {
+        std::cout << "Ignoring stale node (heartbeat age: " << heartbeatAge
+                  << "ms)" << std::endl;
+        continue;
+      }
+
+      if (NodeIdentity::hasPriority(localNodeId_, conflict.nodeId)) {
+        nodesToForceRelease.push_back(conflict.senderSteamID);
+      } else {
+        canClaim = false;
+        break;
+      }
     }
-
-    if (NodeIdentity::hasPriority(localNodeId_, conflict.nodeId)) {
-      nodesToForceRelease.push_back(conflict.senderSteamID);
-    } else {
-      canClaim = false;
-      break;
+    if (!canClaim) {
+      continue;
     }
-  }
 
-  if (canClaim) {
     for (auto steamID : nodesToForceRelease) {
-      sendForcedRelease(candidateIP_, steamID);
+      sendForcedRelease(candidate, steamID);
     }
 
     std::cout << "IP negotiation success. Local IP: "
-              << ((candidateIP_ >> 24) & 0xFF) << "."
-              << ((candidateIP_ >> 16) & 0xFF) << "."
-              << ((candidateIP_ >> 8) & 0xFF) << "." << (candidateIP_ & 0xFF)
+              << ((candidate >> 24) & 0xFF) << "." << ((candidate >> 16) & 0xFF)
+              << "." << ((candidate >> 8) & 0xFF) << "." << (candidate & 0xFF)
               << std::endl;
 
-    state_ = NegotiationState::STABLE;
-    localIP_ = candidateIP_;
+    {
+      std::lock_guard<std::mutex> lock(probeMutex_);
+      candidateIP_ = candidate;
+      localIP_ = candidate;
+      state_ = NegotiationState::STABLE;
+    }
     sendAddressAnnounce();
 
     if (successCallback_) {
       successCallback_(localIP_, localNodeId_);
     }
-  } else {
-    std::cout << "Lost IP arbitration, reselecting with new offset..."
-              << std::endl;
-    probeOffset_++;
-    startNegotiation();
+    return;
   }
+
+  std::cout << "Lost IP arbitration, reselecting with new offset..."
+            << std::endl;
+  probeOffset_ += static_cast<uint32_t>(std::max<size_t>(candidates.size(), 1));
+  startNegotiation();
 }
 
-void IpNegotiator::handleProbeRequest(const ProbeRequestPayload &request,
-                                      CSteamID senderSteamID) {
-  const uint32_t requestedIP = ntohl(request.ipAddress);
-  bool shouldRespond = false;
-
-  if (state_ == NegotiationState::STABLE && requestedIP == localIP_) {
-    shouldRespond = true;
-  } else if (state_ == NegotiationState::PROBING &&
-             requestedIP == candidateIP_) {
-    if (NodeIdentity::hasPriority(localNodeId_, request.nodeId)) {
-      shouldRespond = true;
-    } else {
-      std::cout << "Lost probe contention, reselecting..." << std::endl;
-      probeOffset_++;
-      startNegotiation();
-      return;
+void IpNegotiator::handleProbeRequest(
+    const ProbeRequestPayload &request,
+    const std::vector<uint32_t> &extraCandidates, CSteamID senderSteamID) {
+  const uint32_t probeIP = ntohl(request.ipAddress);
+  std::vector<uint32_t> requested{probeIP};
+  requested.insert(requested.end(), extraCandidates.begin(),
+                   extraCandidates.end());
+
+  std::vector<uint32_t> conflicting;
+  bool lostAll = false;
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    for (const uint32_t ip : requested) {
+      if (state_ == NegotiationState::STABLE && ip == localIP_) {
+        conflicting.push_back(ip);
+      } else if (state_ == NegotiationState::PROBING && !probeResolved_ &&
+                 std::find(candidates_.begin(), candidates_.end(), ip) !=
+                     candidates_.end()) {
+        if (NodeIdentity::hasPriority(localNodeId_, request.nodeId)) {
+          conflicting.push_back(ip);
+        } else {
+          lostAll = dropCandidateLocked(ip);
+        }
+      }
     }
   }
 
-  if (shouldRespond && sendCallback_) {
-    ProbeResponsePayload response;
-    response.ipAddress = htonl(requestedIP);
-    response.nodeId = localNodeId_;
+  if (sendCallback_) {
     const auto now = std::chrono::steady_clock::now();
-    response.lastHeartbeatMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-                                   now.time_since_epoch())
-                                   .count();
+    for (const uint32_t ip : conflicting) {
+      ProbeResponsePayload response;
+      response.ipAddress = htonl(ip);
+      response.nodeId = localNodeId_;
+      response.lastHeartbeatMs =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              now.time_since_epoch())
+              .count();
+
+      sendCallback_(VpnMessageType::PROBE_RESPONSE,
+                    reinterpret_cast<const uint8_t *>(&response),
+                    sizeof(response), senderSteamID, true);
+      std::cout << "Sent conflict response for IP" << std::endl;
+    }
+  }
+  // Reliable sends are ordered, so the ack lands after the responses
+  sendProbeAck(probeIP, senderSteamID);
 
-    sendCallback_(VpnMessageType::PROBE_RESPONSE,
-                  reinterpret_cast<const uint8_t *>(&response),
-                  sizeof(response), senderSteamID, true);
-    std::cout << "Sent conflict response for IP" << std::endl;
+  if (lostAll) {
+    std::cout << "Lost probe contention, reselecting..." << std::endl;
+    probeOffset_ += MAX_PROBE_CANDIDATES;
+    startNegotiation();
   }
 }
 
 void IpNegotiator::handleProbeResponse(const ProbeResponsePayload &response,
                                        CSteamID senderSteamID) {
-  if (state_ != NegotiationState::PROBING) {
-    return;
-  }
   const uint32_t conflictIP = ntohl(response.ipAddress);
-  if (conflictIP != candidateIP_) {
+  std::lock_guard<std::mutex> lock(probeMutex_);
+  if (state_ != NegotiationState::PROBING || probeResolved_ ||
+      std::find(candidates_.begin(), candidates_.end(), conflictIP) ==
+          candidates_.end()) {
     return;
   }
-  std::lock_guard<std::mutex> lock(conflictsMutex_);
   ConflictInfo info;
+  info.ipAddress = conflictIP;
   info.nodeId = response.nodeId;
   info.lastHeartbeatMs = response.lastHeartbeatMs;
   info.senderSteamID = senderSteamID;
@@ -248,8 +406,22 @@ void IpNegotiator::handleProbeResponse(const ProbeResponsePayload &response,
             << NodeIdentity::toString(response.nodeId) << std::endl;
 }
 
+void IpNegotiator::handleProbeAck(const ProbeAckPayload &ack,
+                                  CSteamID senderSteamID) {
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    if (state_ != NegotiationState::PROBING || probeResolved_ ||
+        ntohl(ack.ipAddress) != probeRoundIP_ ||
+        awaitingAcks_.erase(senderSteamID) == 0 || !awaitingAcks_.empty()) {
+      return;
+    }
+  }
+  std::cout << "All peers answered the probe, deciding early" << std::endl;
+  resolveProbe();
+}
+
 void IpNegotiator::handleAddressAnnounce(
-    const AddressAnnouncePayload &announce, CSteamID peerSteamID,
+    const AddressAnnouncePayload &announce, bool resumed, CSteamID peerSteamID,
     const std::string &peerName) {
   const uint32_t announcedIP = ntohl(announce.ipAddress);
   std::cout << "Received address announce: " << ((announcedIP >> 24) & 0xFF)
@@ -259,31 +431,62 @@ void IpNegotiator::handleAddressAnnounce(
             << std::endl;
 
   if (announcedIP == localIP_ && state_ == NegotiationState::STABLE) {
-    if (!NodeIdentity::hasPriority(localNodeId_, announce.nodeId)) {
+    bool ownResumed;
+    {
+      std::lock_guard<std::mutex> lock(probeMutex_);
+      ownResumed = resumePendingLocked();
+    }
+    if (ownResumed ||
+        (!resumed && !NodeIdentity::hasPriority(localNodeId_, announce.nodeId))) {
       std::cout << "Address conflict detected, reselecting..." << std::endl;
       probeOffset_++;
       startNegotiation();
       return;
     }
-    sendForcedRelease(announcedIP, peerSteamID);
+    if (resumed) {
+      // The resumer gives way on hearing that we hold the address
+      sendAddressAnnounceTo(peerSteamID);
+    } else {
+      sendForcedRelease(announcedIP, peerSteamID);
+    }
     return;
   }
 
   markIPUsed(announcedIP);
+
+  bool lostAll = false;
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    if (state_ == NegotiationState::PROBING && !probeResolved_) {
+      lostAll = dropCandidateLocked(announcedIP);
+    }
+  }
+  if (lostAll) {
+    std::cout << "Probed addresses announced by peers, reselecting..."
+              << std::endl;
+    probeOffset_ += MAX_PROBE_CANDIDATES;
+    startNegotiation();
+  }
 }
 
 void IpNegotiator::handleForcedRelease(const ForcedReleasePayload &release,
                                        CSteamID senderSteamID) {
   const uint32_t releasedIP = ntohl(release.ipAddress);
   bool shouldRelease = false;
-
-  if (releasedIP == localIP_ && state_ == NegotiationState::STABLE) {
-    if (!NodeIdentity::hasPriority(localNodeId_, release.winnerNodeId)) {
-      shouldRelease = true;
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    // A resumed lease gives way whatever the priority
+    const bool ownResumed = releasedIP == localIP_ && resumePendingLocked();
+    if (!ownResumed &&
+        NodeIdentity::hasPriority(localNodeId_, release.winnerNodeId)) {
+      return;
     }
-  } else if (releasedIP == candidateIP_ && state_ == NegotiationState::PROBING) {
-    if (!NodeIdentity::hasPriority(localNodeId_, release.winnerNodeId)) {
+    if (releasedIP == localIP_ && state_ == NegotiationState::STABLE) {
       shouldRelease = true;
+    } else if (state_ == NegotiationState::PROBING && !probeResolved_ &&
+               std::find(candidates_.begin(), candidates_.end(),
+                         releasedIP) != candidates_.end()) {
+      shouldRelease = dropCandidateLocked(releasedIP);
     }
   }
 
@@ -299,24 +502,35 @@ void IpNegotiator::sendAddressAnnounce() {
   if (!broadcastCallback_) {
     return;
   }
-  AddressAnnouncePayload payload;
-  payload.ipAddress = htonl(localIP_);
-  payload.nodeId = localNodeId_;
-  broadcastCallback_(VpnMessageType::ADDRESS_ANNOUNCE,
-                     reinterpret_cast<const uint8_t *>(&payload),
-                     sizeof(payload), true);
+  sendAddressAnnounceMessage(nullptr);
 }
 
 void IpNegotiator::sendAddressAnnounceTo(CSteamID targetSteamID) {
   if (!sendCallback_ || state_ != NegotiationState::STABLE || localIP_ == 0) {
     return;
   }
+  sendAddressAnnounceMessage(&targetSteamID);
+}
+
+void IpNegotiator::sendAddressAnnounceMessage(const CSteamID *targetSteamID) {
   AddressAnnouncePayload payload;
   payload.ipAddress = htonl(localIP_);
   payload.nodeId = localNodeId_;
-  sendCallback_(VpnMessageType::ADDRESS_ANNOUNCE,
-                reinterpret_cast<const uint8_t *>(&payload), sizeof(payload),
-                targetSteamID, true);
+  uint8_t buffer[sizeof(payload) + 1];
+  std::memcpy(buffer, &payload, sizeof(payload));
+  size_t length = sizeof(payload);
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    if (resumePendingLocked()) {
+      buffer[length++] = ANNOUNCE_FLAG_RESUMED;
+    }
+  }
+  if (targetSteamID) {
+    sendCallback_(VpnMessageType::ADDRESS_ANNOUNCE, buffer, length,
+                  *targetSteamID, true);
+  } else {
+    broadcastCallback_(VpnMessageType::ADDRESS_ANNOUNCE, buffer, length, true);
+  }
 }
 
 void IpNegotiator::sendForcedRelease(uint32_t ipAddress,
@@ -334,11 +548,17 @@ void IpNegotiator::sendForcedRelease(uint32_t ipAddress,
 }
 
 void IpNegotiator::markIPUsed(uint32_t ip) {
+  if ((ip & subnetMask_) != (baseIP_ & subnetMask_)) {
+    return;
+  }
   std::lock_guard<std::mutex> lock(usedIPsMutex_);
-  usedIPs_.insert(ip);
+  usedHosts_.set(ip & ~subnetMask_);
 }
 
 void IpNegotiator::markIPUnused(uint32_t ip) {
+  if ((ip & subnetMask_) != (baseIP_ & subnetMask_)) {
+    return;
+  }
   std::lock_guard<std::mutex> lock(usedIPsMutex_);
-  usedIPs_.erase(ip);
+  usedHosts_.clear(ip & ~subnetMask_);
 }
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "host_bitmap.h"
 #include "node_identity.h"
+#include "timer_wheel.h"
 #include "vpn_protocol.h"
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <map>
@@ -13,6 +16,7 @@
 enum class NegotiationState { IDLE, PROBING, STABLE };
 
 struct ConflictInfo {
+  uint32_t ipAddress;
   NodeID nodeId;
   int64_t lastHeartbeatMs;
   CSteamID senderSteamID;
@@ -24,6 +28,7 @@ using VpnSendMessageCallback =
 using VpnBroadcastMessageCallback =
     std::function<void(VpnMessageType type, const uint8_t *payload,
                        size_t length, bool reliable)>;
+using VpnPeerListCallback = std::function<std::set<CSteamID>()>;
 using NegotiationSuccessCallback =
     std::function<void(uint32_t ipAddress, const NodeID &nodeId)>;
 
@@ -35,20 +40,36 @@ public:
   void setSendCallback(VpnSendMessageCallback sendCb,
                        VpnBroadcastMessageCallback broadcastCb);
   void setSuccessCallback(NegotiationSuccessCallback callback);
+  // Peers expected to PROBE_ACK a round. Once all of them have, the round
+  // is decided without waiting out PROBE_TIMEOUT_MS.
+  void setPeerListCallback(VpnPeerListCallback callback);
+  // Each probe arms a PROBE_TIMEOUT_MS timer on `timers` that runs
+  // checkTimeout(). Without a wheel the caller must poll checkTimeout().
+  void setTimerWheel(TimerWheel *timers);
   void reset();
   void startNegotiation();
+  // Claims `ip` (e.g. a cached lease) without probing and announces it as
+  // resumed. Until PROBE_TIMEOUT_MS passes, any conflicting announce or
+  // FORCED_RELEASE falls back to normal probing whatever the NodeID
+  // priority; returns false when `ip` is unusable here.
+  bool resumeLease(uint32_t ip);
   void checkTimeout();
+  // `extraCandidates` (host order) are the candidates after the first.
   void handleProbeRequest(const ProbeRequestPayload &request,
+                          const std::vector<uint32_t> &extraCandidates,
                           CSteamID senderSteamID);
   void handleProbeResponse(const ProbeResponsePayload &response,
                            CSteamID senderSteamID);
+  void handleProbeAck(const ProbeAckPayload &ack, CSteamID senderSteamID);
+  // `resumed` is the sender's ANNOUNCE_FLAG_RESUMED; such a claim never
+  // displaces an address we hold.
   void handleAddressAnnounce(const AddressAnnouncePayload &announce,
-                             CSteamID peerSteamID,
+                             bool resumed, CSteamID peerSteamID,
                              const std::string &peerName);
   void handleForcedRelease(const ForcedReleasePayload &release,
                            CSteamID senderSteamID);
 
-  NegotiationState getState() const { return state_; }
+  NegotiationState getState() const { return state_.load(); }
   uint32_t getLocalIP() const { return localIP_; }
   const NodeID &getLocalNodeID() const { return localNodeId_; }
   uint32_t getCandidateIP() const { return candidateIP_; }
@@ -59,9 +80,17 @@ public:
   void markIPUnused(uint32_t ip);
 
 private:
+  uint32_t hostCount() const;
   uint32_t generateCandidateIP(uint32_t offset);
   uint32_t findNextAvailableIP(uint32_t startIP);
-  void sendProbeRequest();
+  std::vector<uint32_t> pickCandidates();
+  // True when the last candidate of the round is gone.
+  bool dropCandidateLocked(uint32_t ip);
+  bool resumePendingLocked();
+  void sendAddressAnnounceMessage(const CSteamID *targetSteamID);
+  void resolveProbe();
+  void sendProbeRequest(const std::vector<uint32_t> &candidates);
+  void sendProbeAck(uint32_t probeIP, CSteamID targetSteamID);
   void sendForcedRelease(uint32_t ipAddress, CSteamID targetSteamID);
 
   NodeID localNodeId_;
@@ -70,17 +99,30 @@ private:
   uint32_t baseIP_;
   uint32_t subnetMask_;
 
-  NegotiationState state_;
+  std::atomic<NegotiationState> state_;
   uint32_t candidateIP_;
   uint32_t probeOffset_;
   std::chrono::steady_clock::time_point probeStartTime_;
+  TimerWheel *timers_ = nullptr;
+  std::atomic<TimerWheel::TimerId> probeTimer_{TimerWheel::kInvalidTimer};
 
+  // Current probe round, guarded by probeMutex_. Candidates are kept in
+  // preference order; the first one without a winning conflict is claimed.
+  std::vector<uint32_t> candidates_;
+  uint32_t probeRoundIP_ = 0;
+  bool probeResolved_ = false;
+  std::set<CSteamID> awaitingAcks_;
   std::vector<ConflictInfo> collectedConflicts_;
-  std::mutex conflictsMutex_;
-  std::set<uint32_t> usedIPs_;
+  // A resumed lease not yet validated by a quiet probe timeout
+  bool resumePending_ = false;
+  std::chrono::steady_clock::time_point resumedAt_;
+  std::mutex probeMutex_;
+  // Indexed by host part (ip & ~subnetMask_)
+  HostBitmap usedHosts_;
   std::mutex usedIPsMutex_;
 
   VpnSendMessageCallback sendCallback_;
   VpnBroadcastMessageCallback broadcastCallback_;
   NegotiationSuccessCallback successCallback_;
+  VpnPeerListCallback peerListCallback_;
 };
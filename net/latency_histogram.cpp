@@ -0,0 +1,77 @@
+#include "latency_histogram.h"
+
+namespace {
+int bucketFor(std::int64_t micros) {
+  int bucket = 0;
+  while (micros > 0 && bucket < LatencyHistogram::kBuckets - 1) {
+    micros >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+// Upper edge of a bucket, reported as the percentile value
+std::int64_t bucketCeiling(int bucket) {
+  return bucket == 0 ? 0 : (std::int64_t(1) << bucket) - 1;
+}
+} // namespace
+
+void LatencyHistogram::record(std::int64_t micros) {
+  if (micros < 0) {
+    micros = 0;
+  }
+  buckets_[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+
+  std::int64_t seen = max_.load(std::memory_order_relaxed);
+  while (micros > seen &&
+         !max_.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+  }
+
+  const std::int64_t previous =
+      last_.exchange(micros, std::memory_order_relaxed);
+  if (previous >= 0) {
+    const std::int64_t delta =
+        micros > previous ? micros - previous : previous - micros;
+    std::int64_t jitter = jitterX16_.load(std::memory_order_relaxed);
+    // J += (|D| - J) / 16; a lost race only drops one smoothing step
+    jitterX16_.compare_exchange_strong(jitter, jitter + delta - jitter / 16,
+                                       std::memory_order_relaxed);
+  }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot snap;
+  std::array<std::uint64_t, kBuckets> counts;
+  for (int i = 0; i < kBuckets; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    snap.count += counts[i];
+  }
+  snap.maxUs = max_.load(std::memory_order_relaxed);
+  snap.jitterUs = jitterX16_.load(std::memory_order_relaxed) / 16;
+  if (snap.count == 0) {
+    return snap;
+  }
+
+  const std::uint64_t p50Rank = (snap.count + 1) / 2;
+  const std::uint64_t p99Rank = snap.count - snap.count / 100;
+  std::uint64_t seen = 0;
+  bool havePercentile50 = false;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += counts[i];
+    if (!havePercentile50 && seen >= p50Rank) {
+      snap.p50Us = bucketCeiling(i);
+      havePercentile50 = true;
+    }
+    if (seen >= p99Rank) {
+      snap.p99Us = bucketCeiling(i);
+      break;
+    }
+  }
+  if (snap.p99Us > snap.maxUs) {
+    snap.p99Us = snap.maxUs;
+  }
+  if (snap.p50Us > snap.maxUs) {
+    snap.p50Us = snap.maxUs;
+  }
+  return snap;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free log2 histogram of latencies in microseconds, plus an RFC 3550
+// style smoothed jitter over consecutive samples. record() may run on any
+// thread; snapshot() is approximate while samples are still arriving.
+class LatencyHistogram {
+public:
+    // Bucket i counts samples in [2^(i-1), 2^i) us; the last one is open-ended
+    static constexpr int kBuckets = 24;
+
+    struct Snapshot {
+        std::uint64_t count = 0;
+        std::int64_t p50Us = 0;
+        std::int64_t p99Us = 0;
+        std::int64_t maxUs = 0;
+        std::int64_t jitterUs = 0;
+    };
+
+    void record(std::int64_t micros);
+    Snapshot snapshot() const;
+
+private:
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+    std::atomic<std::int64_t> max_{0};
+    std::atomic<std::int64_t> last_{-1};
+    // Smoothed jitter scaled by 16 so the 1/16 gain stays integral
+    std::atomic<std::int64_t> jitterX16_{0};
+};
@@ -0,0 +1,104 @@
+#include "lease_cache.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+int64_t wallClockMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+LeaseCache::LeaseCache(std::string path) : path_(std::move(path)) {}
+
+void LeaseCache::setPath(std::string path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  path_ = std::move(path);
+}
+
+bool LeaseCache::lookup(uint64_t lobbyId, uint32_t baseIP, uint32_t subnetMask,
+                        uint32_t &outIP) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (path_.empty() || lobbyId == 0) {
+    return false;
+  }
+  for (const Entry &entry : loadLocked(wallClockMs())) {
+    if (entry.lobbyId == lobbyId && entry.baseIP == baseIP &&
+        entry.subnetMask == subnetMask) {
+      outIP = entry.ip;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LeaseCache::store(uint64_t lobbyId, uint32_t baseIP, uint32_t subnetMask,
+                       uint32_t ip, std::chrono::milliseconds lease) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (path_.empty() || lobbyId == 0 || ip == 0) {
+    return;
+  }
+  const int64_t nowMs = wallClockMs();
+  std::vector<Entry> entries = loadLocked(nowMs);
+  Entry fresh;
+  fresh.lobbyId = lobbyId;
+  fresh.baseIP = baseIP;
+  fresh.subnetMask = subnetMask;
+  fresh.ip = ip;
+  fresh.expiresMs = nowMs + lease.count();
+
+  std::vector<Entry> next{fresh};
+  for (const Entry &entry : entries) {
+    if (next.size() >= kMaxEntries) {
+      break;
+    }
+    if (!(entry.lobbyId == lobbyId && entry.baseIP == baseIP &&
+          entry.subnetMask == subnetMask)) {
+      next.push_back(entry);
+    }
+  }
+  saveLocked(next);
+}
+
+std::vector<LeaseCache::Entry> LeaseCache::loadLocked(int64_t nowMs) const {
+  std::vector<Entry> entries;
+  std::ifstream in(path_);
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    Entry entry;
+    if (fields >> entry.lobbyId >> entry.baseIP >> entry.subnetMask >>
+            entry.ip >> entry.expiresMs &&
+        entry.expiresMs > nowMs) {
+      entries.push_back(entry);
+    }
+  }
+  return entries;
+}
+
+void LeaseCache::saveLocked(const std::vector<Entry> &entries) const {
+  // Write a sibling file and swap it in so a crash never leaves half a cache
+  const std::string tempPath = path_ + ".tmp";
+  {
+    std::ofstream out(tempPath, std::ios::trunc);
+    for (const Entry &entry : entries) {
+      out << entry.lobbyId << ' ' << entry.baseIP << ' ' << entry.subnetMask
+          << ' ' << entry.ip << ' ' << entry.expiresMs << '\n';
+    }
+    if (!out) {
+      std::cerr << "Failed to write lease cache " << tempPath << std::endl;
+      return;
+    }
+  }
+#ifdef _WIN32
+  // rename() does not replace an existing file here; elsewhere it swaps
+  // atomically and removing first would open a window with no cache
+  std::remove(path_.c_str());
+#endif
+  if (std::rename(tempPath.c_str(), path_.c_str()) != 0) {
+    std::cerr << "Failed to replace lease cache " << path_ << std::endl;
+  }
+}
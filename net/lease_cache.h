@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Last address held per (lobby, subnet), kept in a small text file so a
+// rejoin can reclaim it without renegotiating. Entries carry a wall-clock
+// expiry because they have to survive a restart.
+class LeaseCache {
+public:
+  explicit LeaseCache(std::string path = {});
+
+  // An empty path disables the cache.
+  void setPath(std::string path);
+  bool lookup(uint64_t lobbyId, uint32_t baseIP, uint32_t subnetMask,
+              uint32_t &outIP) const;
+  void store(uint64_t lobbyId, uint32_t baseIP, uint32_t subnetMask,
+             uint32_t ip, std::chrono::milliseconds lease);
+
+private:
+  static constexpr size_t kMaxEntries = 32;
+
+  struct Entry {
+    uint64_t lobbyId = 0;
+    uint32_t baseIP = 0;
+    uint32_t subnetMask = 0;
+    uint32_t ip = 0;
+    int64_t expiresMs = 0; // system_clock, ms since epoch
+  };
+
+  std::vector<Entry> loadLocked(int64_t nowMs) const;
+  void saveLocked(const std::vector<Entry> &entries) const;
+
+  std::string path_;
+  mutable std::mutex mutex_;
+};
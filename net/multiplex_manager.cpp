@@ -1,4 +1,5 @@
 #include "multiplex_manager.h"
+#include "buffer_pool.h"
 #include <algorithm>
 #include <chrono>
 #include <cstring>
@@ -6,12 +7,25 @@
 #include <random>
 
 namespace {
-// Keep chunks close to path MTU to reduce Steam UDP fragmentation/lock pressure
-constexpr std::size_t kTunnelChunkBytes =
-    1100; // slightly larger chunks to reduce fragment count
-constexpr std::size_t kSendBufferBytes = 8 * 1024 * 1024;
-constexpr std::size_t kHighWaterBytes = 512 * 1024; // tighter throttling
-constexpr std::size_t kLowWaterBytes = 256 * 1024;
+// Interactive floor: keep chunks close to path MTU to reduce Steam UDP
+// fragmentation/lock pressure when the link is idle or latency-bound
+constexpr std::size_t kMinChunkBytes = 1100;
+// Bulk ceiling: far below Steam's 512 KiB message limit and small enough that
+// one stream cannot hold the reliable channel for long
+constexpr std::size_t kMaxChunkBytes = 64 * 1024;
+
+constexpr std::size_t kIdBytes = 7; // 6 + null
+
+// Writes up to this size are coalesced across streams into one Steam message
+// of at most one MTU-sized chunk, flushed after a short deadline.
+constexpr std::size_t kCoalesceMaxPayload = 512;
+constexpr std::size_t kMaxBatchBytes = kMinChunkBytes;
+constexpr auto kCoalesceDeadline = std::chrono::microseconds(200);
+// Stream ids are alphanumeric and UDP tunnel packets start with '\x02', so
+// this leading byte is unambiguous.
+constexpr char kBatchMarker = '\x03';
+// Upper bound on Steam payloads handed to one gather write (IOV_MAX-safe)
+constexpr std::size_t kMaxGatherWrites = 64;
 
 // Simple, local ID generator to avoid pulling in the full nanoid dependency
 std::string generateId(std::size_t length = 6) {
@@ -34,8 +48,11 @@ MultiplexManager::MultiplexManager(ISteamNetworkingSockets *steamInterface,
                                    boost::asio::io_context &io_context,
                                    bool &isHost, int &localPort)
     : steamInterface_(steamInterface), steamConn_(steamConn),
-      io_context_(io_context), isHost_(isHost), localPort_(localPort) {
-  sendTimer_ = std::make_unique<boost::asio::steady_timer>(io_context_);
+      io_context_(io_context), isHost_(isHost), localPort_(localPort),
+      budget_(steamInterface, steamConn, io_context) {
+  budget_.setRefillCallback([this]() { scheduleFlush(); });
+  batchTimer_ = std::make_unique<boost::asio::steady_timer>(io_context_);
+  batch_.reserve(kMaxBatchBytes);
 }
 
 MultiplexManager::~MultiplexManager() {
@@ -47,7 +64,36 @@ MultiplexManager::~MultiplexManager() {
   clientMap_.clear();
 }
 
-std::string MultiplexManager::addClient(std::shared_ptr<tcp::socket> socket) {
+void MultiplexManager::shutdown() {
+  if (closed_.exchange(true)) {
+    return;
+  }
+  std::vector<std::string> ids;
+  {
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    ids.reserve(clientMap_.size());
+    for (const auto &pair : clientMap_) {
+      ids.push_back(pair.first);
+    }
+  }
+  // No disconnect frames: there is no connection left to carry them
+  for (const auto &id : ids) {
+    removeClient(id);
+  }
+  batchTimer_->cancel();
+  budget_.cancel();
+  {
+    std::lock_guard<std::mutex> lock(batchMutex_);
+    batch_.clear();
+  }
+  std::lock_guard<std::mutex> queueLock(queueMutex_);
+  pendingPackets_.clear();
+  sendOrder_.clear();
+  sendOrderSet_.clear();
+}
+
+std::string MultiplexManager::addClient(std::shared_ptr<tcp::socket> socket,
+                                        std::function<void()> onClosed) {
   std::string id;
   {
     std::lock_guard<std::mutex> lock(mapMutex_);
@@ -56,7 +102,9 @@ std::string MultiplexManager::addClient(std::shared_ptr<tcp::socket> socket) {
     } while (clientMap_.find(id) != clientMap_.end());
 
     clientMap_[id] = socket;
-    readBuffers_[id].resize(1048576);
+    if (onClosed) {
+      closeCallbacks_[id] = std::move(onClosed);
+    }
     missingClients_.erase(id);
   }
   startAsyncRead(id);
@@ -66,15 +114,23 @@ std::string MultiplexManager::addClient(std::shared_ptr<tcp::socket> socket) {
 
 bool MultiplexManager::removeClient(const std::string &id) {
   bool removed = false;
-  std::lock_guard<std::mutex> lock(mapMutex_);
-  auto it = clientMap_.find(id);
-  if (it != clientMap_.end()) {
-    it->second->close();
-    clientMap_.erase(it);
-    removed = true;
+  std::function<void()> onClosed;
+  {
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    auto it = clientMap_.find(id);
+    if (it != clientMap_.end()) {
+      it->second->close();
+      clientMap_.erase(it);
+      removed = true;
+    }
+    writers_.erase(id);
+    auto cb = closeCallbacks_.find(id);
+    if (cb != closeCallbacks_.end()) {
+      onClosed = std::move(cb->second);
+      closeCallbacks_.erase(cb);
+    }
+    missingClients_.erase(id);
   }
-  readBuffers_.erase(id);
-  missingClients_.erase(id);
   {
     std::lock_guard<std::mutex> lock(pausedMutex_);
     pausedReads_.erase(id);
@@ -96,6 +152,9 @@ bool MultiplexManager::removeClient(const std::string &id) {
   if (shouldResume) {
     resumePausedReads();
   }
+  if (onClosed) {
+    onClosed();
+  }
   return removed;
 }
 
@@ -109,58 +168,42 @@ MultiplexManager::getClient(const std::string &id) {
   return nullptr;
 }
 
-std::vector<char> MultiplexManager::buildPacket(const std::string &id,
-                                                const char *data, size_t len,
-                                                int type) const {
+std::size_t MultiplexManager::activeStreams() {
+  std::lock_guard<std::mutex> lock(mapMutex_);
+  return clientMap_.size();
+}
+
+void MultiplexManager::buildPacket(std::vector<char> &out,
+                                   const std::string &id, const char *data,
+                                   size_t len, int type) const {
   const size_t idLen = id.size() + 1;
   const size_t payloadLen = (type == 0 ? len : 0);
   const size_t packetSize = idLen + sizeof(uint32_t) + payloadLen;
-  std::vector<char> packet(packetSize);
-  std::memcpy(packet.data(), id.c_str(), idLen);
-  auto *pType = reinterpret_cast<uint32_t *>(packet.data() + idLen);
-  *pType = type;
+  out.resize(packetSize);
+  std::memcpy(out.data(), id.c_str(), idLen);
+  const uint32_t packetType = static_cast<uint32_t>(type);
+  std::memcpy(out.data() + idLen, &packetType, sizeof(uint32_t));
   if (payloadLen > 0 && data) {
-    std::memcpy(packet.data() + idLen + sizeof(uint32_t), data, payloadLen);
+    std::memcpy(out.data() + idLen + sizeof(uint32_t), data, payloadLen);
   }
-  return packet;
 }
 
-bool MultiplexManager::trySendPacket(const std::vector<char> &packet) {
-  if (packet.empty()) {
+bool MultiplexManager::trySendPacket(const char *packet, size_t size) {
+  if (size == 0) {
     return true;
   }
-
-  SteamNetConnectionRealTimeStatus_t status{};
-  if (steamInterface_->GetConnectionRealTimeStatus(steamConn_, &status, 0,
-                                                   nullptr)) {
-    if (static_cast<std::size_t>(status.m_cbPendingReliable) >=
-        kHighWaterBytes) {
-      lastBlocked_ = std::chrono::steady_clock::now();
-      int current = backoffMs_.load(std::memory_order_relaxed);
-      int next = std::min(current * 2, 200);
-      backoffMs_.store(next, std::memory_order_relaxed);
-      sendBlocked_.store(true, std::memory_order_relaxed);
-      return false;
-    }
-  }
-
-  if (isSendSaturated()) {
+  if (!budget_.tryConsume(size)) {
     return false;
   }
   EResult result = steamInterface_->SendMessageToConnection(
-      steamConn_, packet.data(), static_cast<uint32>(packet.size()),
+      steamConn_, packet, static_cast<uint32>(size),
       k_nSteamNetworkingSend_Reliable | k_nSteamNetworkingSend_NoNagle,
       nullptr);
   if (result == k_EResultOK) {
-    backoffMs_.store(5, std::memory_order_relaxed);
     return true;
   }
   if (result == k_EResultLimitExceeded) {
-    lastBlocked_ = std::chrono::steady_clock::now();
-    int current = backoffMs_.load(std::memory_order_relaxed);
-    int next = std::min(current * 2, 100);
-    backoffMs_.store(next, std::memory_order_relaxed);
-    sendBlocked_.store(true, std::memory_order_relaxed);
+    budget_.markExhausted();
     return false;
   }
 
@@ -188,11 +231,8 @@ void MultiplexManager::enqueuePacket(const std::string &id,
 }
 
 void MultiplexManager::flushPendingPackets() {
-  if (isSendSaturated()) {
-    return;
-  }
-
   std::unique_lock<std::mutex> lock(queueMutex_);
+  flushScheduled_ = false;
   while (!sendOrder_.empty()) {
     const std::string id = sendOrder_.front();
     sendOrder_.pop_front();
@@ -202,22 +242,29 @@ void MultiplexManager::flushPendingPackets() {
       continue;
     }
     auto &queue = it->second;
-    if (queue.empty()) {
-      pendingPackets_.erase(it);
-      sendOrderSet_.erase(id);
-      continue;
-    }
 
-    const std::vector<char> &packet = queue.front();
-    lock.unlock();
-    const bool sent = trySendPacket(packet);
-    lock.lock();
+    // Each stream spends at most its share of the budget per turn.
+    std::size_t credit = budget_.streamCredit(sendOrder_.size() + 1);
+    bool sent = true;
+    while (!queue.empty() && credit > 0) {
+      const std::vector<char> &packet = queue.front();
+      const std::size_t packetSize = packet.size();
+      lock.unlock();
+      sent = trySendPacket(packet.data(), packetSize);
+      lock.lock();
+      if (!sent) {
+        break;
+      }
+      queue.pop_front();
+      credit -= std::min(credit, packetSize);
+    }
     if (!sent) {
       sendBlocked_.store(true, std::memory_order_relaxed);
-      sendOrder_.push_front(id); // retry this id first when unblocked
+      sendOrder_.push_front(id); // retry this id first when refilled
+      lock.unlock();
+      budget_.waitForRefill(shared_from_this());
       return;
     }
-    queue.pop_front();
     if (!queue.empty()) {
       sendOrder_.push_back(id);
     } else {
@@ -230,68 +277,48 @@ void MultiplexManager::flushPendingPackets() {
   resumePausedReads();
 }
 
-void MultiplexManager::scheduleFlush(std::chrono::milliseconds delay) {
-  bool needSchedule = false;
+void MultiplexManager::scheduleFlush() {
   {
     std::lock_guard<std::mutex> lock(queueMutex_);
-    if (!flushScheduled_ && !sendOrder_.empty()) {
-      flushScheduled_ = true;
-      needSchedule = true;
+    if (flushScheduled_ || sendOrder_.empty()) {
+      return;
     }
+    flushScheduled_ = true;
   }
-  if (!needSchedule) {
-    return;
-  }
-
-  auto nextDelay = delay;
-  if (sendBlocked_.load(std::memory_order_relaxed)) {
-    nextDelay =
-        std::max(nextDelay, std::chrono::milliseconds(backoffMs_.load()));
-  }
-
-  sendTimer_->expires_after(nextDelay);
-  sendTimer_->async_wait([this](const boost::system::error_code &ec) {
-    if (!ec) {
-      flushPendingPackets();
-    }
-    bool shouldReschedule = false;
-    auto rescheduleDelay = std::chrono::milliseconds(5);
-    {
-      std::lock_guard<std::mutex> lock(queueMutex_);
-      flushScheduled_ = false;
-      shouldReschedule = !sendOrder_.empty();
-      if (sendBlocked_.load(std::memory_order_relaxed)) {
-        rescheduleDelay = std::chrono::milliseconds(
-            backoffMs_.load(std::memory_order_relaxed));
-      }
-    }
-    if (shouldReschedule) {
-      scheduleFlush(rescheduleDelay);
-    }
+  boost::asio::post(io_context_, [this, self = shared_from_this()]() {
+    flushPendingPackets();
   });
 }
 
 void MultiplexManager::sendTunnelPacket(const std::string &id, const char *data,
                                         size_t len, int type) {
+  if (closed_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  if (batching_.load(std::memory_order_relaxed) &&
+      (type != 0 || len <= kCoalesceMaxPayload) &&
+      appendToBatch(id, data, len, type)) {
+    return;
+  }
+  // Anything already coalesced must leave first to keep per-stream ordering.
+  flushBatch();
+
+  static thread_local std::vector<char> scratch;
   bool blocked = false;
   auto pushPacket = [this, &id, &blocked](const char *ptr, size_t amount,
                                           int packetType) {
-    auto packet = buildPacket(id, ptr, amount, packetType);
-    if (blocked || isSendSaturated()) {
-      blocked = true;
-      enqueuePacket(id, std::move(packet));
-      return;
-    }
-    if (!trySendPacket(packet)) {
+    buildPacket(scratch, id, ptr, amount, packetType);
+    if (blocked || !trySendPacket(scratch.data(), scratch.size())) {
       blocked = true;
-      enqueuePacket(id, std::move(packet));
+      enqueuePacket(id, scratch);
     }
   };
 
-  if (type == 0 && data && len > kTunnelChunkBytes) {
+  const size_t chunkBytes = currentChunkBytes();
+  if (type == 0 && data && len > chunkBytes) {
     size_t offset = 0;
     while (offset < len) {
-      const size_t chunk = std::min(kTunnelChunkBytes, len - offset);
+      const size_t chunk = std::min(chunkBytes, len - offset);
       pushPacket(data + offset, chunk, 0);
       offset += chunk;
     }
@@ -301,18 +328,138 @@ void MultiplexManager::sendTunnelPacket(const std::string &id, const char *data,
 
   if (blocked) {
     sendBlocked_.store(true, std::memory_order_relaxed);
-    lastBlocked_ = std::chrono::steady_clock::now();
   }
 }
 
-void MultiplexManager::handleTunnelPacket(const char *data, size_t len) {
-  size_t idLen = 7; // 6 + null
+bool MultiplexManager::appendToBatch(const std::string &id, const char *data,
+                                     size_t len, int type) {
+  const size_t idLen = id.size() + 1;
+  const size_t payloadLen = (type == 0 ? len : 0);
+  const size_t frameLen = idLen + sizeof(uint32_t) + payloadLen;
+  if (1 + sizeof(uint16_t) + frameLen > kMaxBatchBytes) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(batchMutex_);
+  if (sendBlocked_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  {
+    // Streams with queued packets must keep draining through their queue.
+    std::lock_guard<std::mutex> queueLock(queueMutex_);
+    if (pendingPackets_.find(id) != pendingPackets_.end()) {
+      return false;
+    }
+  }
+  if (batch_.size() + sizeof(uint16_t) + frameLen > kMaxBatchBytes) {
+    sendBatchLocked();
+    if (sendBlocked_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+  }
+
+  const bool wasEmpty = batch_.empty();
+  if (wasEmpty) {
+    batch_.push_back(kBatchMarker);
+  }
+  const size_t offset = batch_.size();
+  batch_.resize(offset + sizeof(uint16_t) + frameLen);
+  char *frame = batch_.data() + offset;
+  const uint16_t frameLen16 = static_cast<uint16_t>(frameLen);
+  std::memcpy(frame, &frameLen16, sizeof(uint16_t));
+  frame += sizeof(uint16_t);
+  std::memcpy(frame, id.c_str(), idLen);
+  const uint32_t packetType = static_cast<uint32_t>(type);
+  std::memcpy(frame + idLen, &packetType, sizeof(uint32_t));
+  if (payloadLen > 0 && data) {
+    std::memcpy(frame + idLen + sizeof(uint32_t), data, payloadLen);
+  }
+  lock.unlock();
+
+  if (wasEmpty) {
+    boost::asio::post(io_context_, [this, self = shared_from_this()]() {
+      batchTimer_->expires_after(kCoalesceDeadline);
+      batchTimer_->async_wait([this, self](const boost::system::error_code &ec) {
+        if (!ec) {
+          flushBatch();
+        }
+      });
+    });
+  }
+  return true;
+}
+
+void MultiplexManager::flushBatch() {
+  std::lock_guard<std::mutex> lock(batchMutex_);
+  sendBatchLocked();
+}
+
+void MultiplexManager::sendBatchLocked() {
+  if (batch_.empty()) {
+    return;
+  }
+  // A lone frame goes out unwrapped, exactly as it would without coalescing.
+  const char *packet = batch_.data();
+  size_t size = batch_.size();
+  uint16_t firstLen = 0;
+  std::memcpy(&firstLen, packet + 1, sizeof(uint16_t));
+  if (1 + sizeof(uint16_t) + firstLen == size) {
+    packet += 1 + sizeof(uint16_t);
+    size = firstLen;
+  }
+  if (trySendPacket(packet, size)) {
+    batch_.clear();
+    return;
+  }
+
+  // Blocked: hand every frame to its stream queue, preserving order.
+  size_t offset = 1;
+  while (offset + sizeof(uint16_t) <= batch_.size()) {
+    uint16_t frameLen = 0;
+    std::memcpy(&frameLen, batch_.data() + offset, sizeof(uint16_t));
+    offset += sizeof(uint16_t);
+    const char *frame = batch_.data() + offset;
+    enqueuePacket(std::string(frame, kIdBytes - 1),
+                  std::vector<char>(frame, frame + frameLen));
+    offset += frameLen;
+  }
+  batch_.clear();
+  sendBlocked_.store(true, std::memory_order_relaxed);
+}
+
+void MultiplexManager::handleTunnelBatch(const char *data, size_t len,
+                                         const std::shared_ptr<const void> &owner) {
+  size_t offset = 1;
+  while (offset + sizeof(uint16_t) <= len) {
+    uint16_t frameLen = 0;
+    std::memcpy(&frameLen, data + offset, sizeof(uint16_t));
+    offset += sizeof(uint16_t);
+    if (frameLen > len - offset) {
+      std::cerr << "Truncated tunnel batch" << std::endl;
+      return;
+    }
+    handleTunnelPacket(data + offset, frameLen, owner);
+    offset += frameLen;
+  }
+}
+
+void MultiplexManager::handleTunnelPacket(const char *data, size_t len,
+                                          std::shared_ptr<const void> owner) {
+  if (closed_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  if (len > 0 && data[0] == kBatchMarker) {
+    handleTunnelBatch(data, len, owner);
+    return;
+  }
+  size_t idLen = kIdBytes;
   if (len < idLen + sizeof(uint32_t)) {
     std::cerr << "Invalid tunnel packet size" << std::endl;
     return;
   }
-  std::string id(data, 6);
-  uint32_t type = *reinterpret_cast<const uint32_t *>(data + idLen);
+  std::string id(data, idLen - 1);
+  uint32_t type = 0;
+  std::memcpy(&type, data + idLen, sizeof(uint32_t));
   if (type == 0) {
     // Data packet
     size_t dataLen = len - idLen - sizeof(uint32_t);
@@ -341,7 +488,6 @@ void MultiplexManager::handleTunnelPacket(const char *data, size_t len) {
         {
           std::lock_guard<std::mutex> lock(mapMutex_);
           clientMap_[id] = newSocket;
-          readBuffers_[id].resize(1048576);
           socket = newSocket;
         }
         std::cout << "Successfully created TCP client for id " << id
@@ -358,18 +504,7 @@ void MultiplexManager::handleTunnelPacket(const char *data, size_t len) {
     }
     if (socket) {
       missingClients_.erase(id);
-      auto payload =
-          std::make_shared<std::vector<char>>(packetData, packetData + dataLen);
-      boost::asio::async_write(
-          *socket, boost::asio::buffer(*payload),
-          [this, id, payload](const boost::system::error_code &writeEc,
-                              std::size_t) {
-            if (writeEc) {
-              std::cout << "Error writing to TCP client " << id << ": "
-                        << writeEc.message() << std::endl;
-              removeClient(id);
-            }
-          });
+      queueLocalWrite(id, socket, packetData, dataLen, owner);
     } else {
       if (missingClients_.insert(id).second) {
         std::cerr << "No client found for id " << id << std::endl;
@@ -387,33 +522,137 @@ void MultiplexManager::handleTunnelPacket(const char *data, size_t len) {
 }
 
 void MultiplexManager::startAsyncRead(const std::string &id) {
+  if (closed_.load(std::memory_order_relaxed)) {
+    return;
+  }
   auto socket = getClient(id);
   if (!socket) {
     std::cout << "Error: Socket is null for id " << id << std::endl;
     return;
   }
-  socket->async_read_some(
-      boost::asio::buffer(readBuffers_[id]),
-      [this, id](const boost::system::error_code &ec,
-                 std::size_t bytes_transferred) {
-        if (!ec) {
-          if (bytes_transferred > 0) {
-            sendTunnelPacket(id, readBuffers_[id].data(), bytes_transferred, 0);
-            if (sendBlocked_.load(std::memory_order_relaxed)) {
-              std::lock_guard<std::mutex> lock(pausedMutex_);
-              pausedReads_.insert(id);
-              return;
-            }
+  // Wait for readability without a buffer; one is borrowed only once data
+  // has actually arrived.
+  socket->async_wait(
+      tcp::socket::wait_read,
+      [this, self = shared_from_this(), id,
+       socket](const boost::system::error_code &waitEc) {
+        if (waitEc) {
+          if (waitEc != boost::asio::error::operation_aborted) {
+            std::cout << "Error waiting on TCP client " << id << ": "
+                      << waitEc.message() << std::endl;
           }
+          closeLocalClient(id);
+          return;
+        }
+        boost::system::error_code ec;
+        socket->non_blocking(true, ec);
+        const std::size_t available = socket->available(ec);
+        BufferLease buffer = BufferPool::shared().acquire(available);
+        const std::size_t bytes_transferred = socket->read_some(
+            boost::asio::buffer(buffer.data(), buffer.capacity()), ec);
+        if (ec == boost::asio::error::would_block) {
           startAsyncRead(id);
-        } else {
+          return;
+        }
+        if (ec) {
           std::cout << "Error reading from TCP client " << id << ": "
                     << ec.message() << std::endl;
-          removeClient(id);
+          closeLocalClient(id);
+          return;
+        }
+        if (bytes_transferred > 0) {
+          sendTunnelPacket(id, buffer.data(), bytes_transferred, 0);
+          if (sendBlocked_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(pausedMutex_);
+            pausedReads_.insert(id);
+            return;
+          }
         }
+        startAsyncRead(id);
       });
 }
 
+void MultiplexManager::queueLocalWrite(const std::string &id,
+                                       const std::shared_ptr<tcp::socket> &socket,
+                                       const char *data, size_t len,
+                                       std::shared_ptr<const void> owner) {
+  if (len == 0) {
+    return;
+  }
+  if (!owner) {
+    // Caller's buffer does not outlive this call; keep a private copy.
+    auto copy = std::make_shared<std::vector<char>>(data, data + len);
+    data = copy->data();
+    owner = std::move(copy);
+  }
+  std::shared_ptr<LocalWriter> writer;
+  {
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    auto &slot = writers_[id];
+    if (!slot || slot->socket != socket) {
+      slot = std::make_shared<LocalWriter>();
+      slot->socket = socket;
+    }
+    writer = slot;
+  }
+  bool start = false;
+  {
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    writer->queue.push_back(LocalWrite{std::move(owner), data, len});
+    if (!writer->writing) {
+      writer->writing = true;
+      start = true;
+    }
+  }
+  if (start) {
+    writeNextLocal(id, writer);
+  }
+}
+
+void MultiplexManager::writeNextLocal(const std::string &id,
+                                      std::shared_ptr<LocalWriter> writer) {
+  // Everything queued so far goes out as one gather write straight from the
+  // Steam message payloads; the messages are released when it completes.
+  auto inFlight = std::make_shared<std::vector<LocalWrite>>();
+  {
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    if (writer->queue.empty()) {
+      writer->writing = false;
+      return;
+    }
+    while (!writer->queue.empty() && inFlight->size() < kMaxGatherWrites) {
+      inFlight->push_back(std::move(writer->queue.front()));
+      writer->queue.pop_front();
+    }
+  }
+  std::vector<boost::asio::const_buffer> buffers;
+  buffers.reserve(inFlight->size());
+  for (const auto &write : *inFlight) {
+    buffers.emplace_back(write.data, write.len);
+  }
+  boost::asio::async_write(
+      *writer->socket, buffers,
+      [this, self = shared_from_this(), id, writer,
+       inFlight](const boost::system::error_code &writeEc, std::size_t) {
+        if (writeEc) {
+          std::cout << "Error writing to TCP client " << id << ": "
+                    << writeEc.message() << std::endl;
+          closeLocalClient(id);
+          return;
+        }
+        inFlight->clear();
+        writeNextLocal(id, writer);
+      });
+}
+
+void MultiplexManager::closeLocalClient(const std::string &id) {
+  // Only the side that still owned the stream notifies the peer; a close
+  // triggered by the peer's own disconnect frame has already removed it.
+  if (removeClient(id)) {
+    sendTunnelPacket(id, nullptr, 0, 1);
+  }
+}
+
 void MultiplexManager::resumePausedReads() {
   std::vector<std::string> toResume;
   {
@@ -426,40 +665,19 @@ void MultiplexManager::resumePausedReads() {
   }
 }
 
-bool MultiplexManager::isSendSaturated() {
-  if (sendBlocked_.load(std::memory_order_relaxed)) {
-    auto elapsed = std::chrono::steady_clock::now() - lastBlocked_;
-    if (elapsed < std::chrono::milliseconds(backoffMs_.load())) {
-      return true;
-    }
-    // Time to retry; keep going but do not clear the flag yet until we send.
-  }
-
-  SteamNetConnectionRealTimeStatus_t status{};
-  if (steamInterface_->GetConnectionRealTimeStatus(steamConn_, &status, 0,
-                                                   nullptr)) {
-    const std::size_t pending =
-        static_cast<std::size_t>(status.m_cbPendingReliable);
-    if (pending >= kHighWaterBytes) {
-      lastBlocked_ = std::chrono::steady_clock::now();
-      int current = backoffMs_.load(std::memory_order_relaxed);
-      int next = std::min(current * 2, 200);
-      backoffMs_.store(next, std::memory_order_relaxed);
-      sendBlocked_.store(true, std::memory_order_relaxed);
-      return true;
-    }
-    if (pending <= kLowWaterBytes) {
-      sendBlocked_.store(false, std::memory_order_relaxed);
-      backoffMs_.store(5, std::memory_order_relaxed);
-      return false;
-    }
-  }
-
-  return sendBlocked_.load(std::memory_order_relaxed);
-}
-
 void MultiplexManager::removeFromOrder(const std::string &id) {
   sendOrderSet_.erase(id);
   sendOrder_.erase(std::remove(sendOrder_.begin(), sendOrder_.end(), id),
                    sendOrder_.end());
 }
+
+std::size_t MultiplexManager::currentChunkBytes() const {
+  const std::size_t rate = budget_.outBytesPerSec();
+  const std::size_t pingMs =
+      static_cast<std::size_t>(std::max(budget_.pingMs(), 1));
+  // Bulk flows get roughly 1/8 of the bandwidth-delay product (at least ~2 ms
+  // of throughput) per message; interactive flows stay at MTU size.
+  const std::size_t bdp = rate * pingMs / 1000;
+  const std::size_t target = std::max(bdp / 8, rate / 500);
+  return std::clamp(target, kMinChunkBytes, kMaxChunkBytes);
+}
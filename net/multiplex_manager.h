@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -14,24 +15,54 @@
 #include <steam_api.h>
 #include <isteamnetworkingsockets.h>
 #include <steamnetworkingtypes.h>
+#include "send_budget.h"
 
 using boost::asio::ip::tcp;
 
-class MultiplexManager {
+// Tunnel state for one Steam connection. Always owned by a shared_ptr: every
+// pending async handler holds a reference, so the manager is destroyed only
+// after shutdown() has cancelled its work and the last handler has run.
+class MultiplexManager : public std::enable_shared_from_this<MultiplexManager> {
 public:
     MultiplexManager(ISteamNetworkingSockets* steamInterface, HSteamNetConnection steamConn, 
                      boost::asio::io_context& io_context, bool& isHost, int& localPort);
     ~MultiplexManager();
 
-    std::string addClient(std::shared_ptr<tcp::socket> socket);
+    // Called once the Steam connection is gone: closes every local stream
+    // (running its onClosed) and drops queued sends. Later tunnel packets
+    // are ignored.
+    void shutdown();
+
+    // onClosed runs once the stream is torn down, from either side.
+    std::string addClient(std::shared_ptr<tcp::socket> socket, std::function<void()> onClosed = nullptr);
     bool removeClient(const std::string& id);
     std::shared_ptr<tcp::socket> getClient(const std::string& id);
+    // Local streams currently multiplexed over this connection
+    std::size_t activeStreams();
 
     void sendTunnelPacket(const std::string& id, const char* data, size_t len, int type);
+    // Batch frames ('\x03') are always decoded but only sent when enabled:
+    // older peers read the marker as a stream id.
+    void setBatching(bool enabled) { batching_.store(enabled, std::memory_order_relaxed); }
 
-    void handleTunnelPacket(const char* data, size_t len);
+    // `owner` keeps `data` alive (e.g. the received Steam message) until the
+    // local socket write completes; without it the payload is copied.
+    void handleTunnelPacket(const char* data, size_t len, std::shared_ptr<const void> owner = nullptr);
 
 private:
+    struct LocalWrite {
+        std::shared_ptr<const void> owner;
+        const char* data;
+        size_t len;
+    };
+    // Ordered writes to one local socket; a single gather write is in flight
+    struct LocalWriter {
+        std::shared_ptr<tcp::socket> socket;
+        std::mutex mutex;
+        std::deque<LocalWrite> queue;
+        bool writing = false;
+    };
+
     ISteamNetworkingSockets* steamInterface_;
     HSteamNetConnection steamConn_;
     std::unordered_map<std::string, std::shared_ptr<tcp::socket>> clientMap_;
@@ -39,29 +70,43 @@ private:
     boost::asio::io_context& io_context_;
     bool& isHost_;
     int& localPort_;
-    std::unordered_map<std::string, std::vector<char>> readBuffers_;
+    std::unordered_map<std::string, std::function<void()>> closeCallbacks_;
+    std::unordered_map<std::string, std::shared_ptr<LocalWriter>> writers_;
     std::unordered_set<std::string> missingClients_;
     std::map<std::string, std::deque<std::vector<char>>> pendingPackets_;
     std::mutex queueMutex_;
-    std::unique_ptr<boost::asio::steady_timer> sendTimer_;
     bool flushScheduled_ = false;
+    std::atomic<bool> closed_{false};
+    SendBudget budget_;
 
     void startAsyncRead(const std::string& id);
-    std::vector<char> buildPacket(const std::string &id, const char *data, size_t len, int type) const;
-    bool trySendPacket(const std::vector<char> &packet);
+    void buildPacket(std::vector<char> &out, const std::string &id, const char *data, size_t len, int type) const;
+    bool trySendPacket(const char *packet, size_t size);
     void enqueuePacket(const std::string &id, std::vector<char> packet);
     void flushPendingPackets();
-    void scheduleFlush(std::chrono::milliseconds delay = std::chrono::milliseconds(5));
+    void scheduleFlush();
+    void queueLocalWrite(const std::string &id, const std::shared_ptr<tcp::socket> &socket,
+                         const char *data, size_t len, std::shared_ptr<const void> owner);
+    void writeNextLocal(const std::string &id, std::shared_ptr<LocalWriter> writer);
+    void closeLocalClient(const std::string &id);
     void resumePausedReads();
-    bool isSendSaturated();
     void removeFromOrder(const std::string &id);
+    std::size_t currentChunkBytes() const;
+    bool appendToBatch(const std::string &id, const char *data, size_t len, int type);
+    void flushBatch();
+    void sendBatchLocked();
+    void handleTunnelBatch(const char *data, size_t len, const std::shared_ptr<const void> &owner);
 
     std::atomic<bool> sendBlocked_{false};
-    std::atomic<int> backoffMs_{5};
-    std::chrono::steady_clock::time_point lastBlocked_;
     std::unordered_set<std::string> pausedReads_;
     std::mutex pausedMutex_;
     std::unordered_set<std::string> sendOrderSet_;
     std::deque<std::string> sendOrder_;
     std::unordered_map<std::string, std::chrono::steady_clock::time_point> recentConnectFail_;
+
+    // Small writes from all streams coalesced into one Steam message
+    std::atomic<bool> batching_{false};
+    std::vector<char> batch_;
+    std::mutex batchMutex_;
+    std::unique_ptr<boost::asio::steady_timer> batchTimer_;
 };
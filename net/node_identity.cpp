@@ -2,20 +2,34 @@
 
 #include <QCryptographicHash>
 #include <cstring>
-#include <iomanip>
-#include <sstream>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 #include <vector>
 
-NodeID NodeIdentity::generate(CSteamID steamID) {
-  NodeID nodeId{};
-  const uint64_t steamId64 = steamID.ConvertToUint64();
+namespace {
+// Node IDs are a pure function of the Steam ID, so every peer is hashed
+// once. Bounded so a stream of bogus IDs cannot grow it without limit.
+constexpr std::size_t kMaxCachedIds = 4096;
 
+struct NodeIdCache {
+  std::shared_mutex mutex;
+  std::unordered_map<uint64_t, NodeID> ids;
+};
+
+NodeIdCache &nodeIdCache() {
+  static NodeIdCache cache;
+  return cache;
+}
+
+NodeID hashSteamId(uint64_t steamId64) {
   std::vector<uint8_t> input;
   input.resize(sizeof(steamId64) + std::strlen(APP_SECRET_SALT));
   std::memcpy(input.data(), &steamId64, sizeof(steamId64));
   std::memcpy(input.data() + sizeof(steamId64), APP_SECRET_SALT,
               std::strlen(APP_SECRET_SALT));
 
+  NodeID nodeId{};
   const QByteArray hash = QCryptographicHash::hash(
       QByteArray::fromRawData(reinterpret_cast<const char *>(input.data()),
                               static_cast<int>(input.size())),
@@ -25,6 +39,27 @@ NodeID NodeIdentity::generate(CSteamID steamID) {
   }
   return nodeId;
 }
+} // namespace
+
+NodeID NodeIdentity::generate(CSteamID steamID) {
+  const uint64_t steamId64 = steamID.ConvertToUint64();
+  NodeIdCache &cache = nodeIdCache();
+  {
+    std::shared_lock<std::shared_mutex> lock(cache.mutex);
+    auto it = cache.ids.find(steamId64);
+    if (it != cache.ids.end()) {
+      return it->second;
+    }
+  }
+
+  const NodeID nodeId = hashSteamId(steamId64);
+  std::unique_lock<std::shared_mutex> lock(cache.mutex);
+  if (cache.ids.size() >= kMaxCachedIds) {
+    cache.ids.clear();
+  }
+  cache.ids.emplace(steamId64, nodeId);
+  return nodeId;
+}
 
 int NodeIdentity::compare(const NodeID &a, const NodeID &b) {
   for (std::size_t i = 0; i < NODE_ID_SIZE; ++i) {
@@ -39,16 +74,14 @@ int NodeIdentity::compare(const NodeID &a, const NodeID &b) {
 }
 
 std::string NodeIdentity::toString(const NodeID &nodeId, bool full) {
-  std::ostringstream oss;
-  oss << std::hex << std::setfill('0');
+  static constexpr char kHexDigits[] = "0123456789abcdef";
   const std::size_t len = full ? NODE_ID_SIZE : 8;
+  std::string out(len * 2 + (full ? 0 : 3), '.');
   for (std::size_t i = 0; i < len; ++i) {
-    oss << std::setw(2) << static_cast<int>(nodeId[i]);
-  }
-  if (!full) {
-    oss << "...";
+    out[2 * i] = kHexDigits[nodeId[i] >> 4];
+    out[2 * i + 1] = kHexDigits[nodeId[i] & 0x0F];
   }
-  return oss.str();
+  return out;
 }
 
 bool NodeIdentity::isEmpty(const NodeID &nodeId) {
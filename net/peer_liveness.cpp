@@ -0,0 +1,90 @@
+#include "peer_liveness.h"
+
+void PeerLiveness::track(CSteamID peer, Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = peers_.try_emplace(peer);
+  if (inserted) {
+    it->second.lastHeard = now;
+    it->second.lastProbe = now;
+  }
+}
+
+void PeerLiveness::forget(CSteamID peer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = peers_.find(peer);
+  if (it == peers_.end()) {
+    return;
+  }
+  if (it->second.down) {
+    downCount_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  peers_.erase(it);
+}
+
+void PeerLiveness::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  peers_.clear();
+  downCount_.store(0, std::memory_order_relaxed);
+}
+
+void PeerLiveness::noteHeard(CSteamID peer, bool answersKeepalives,
+                             Clock::time_point now,
+                             std::vector<Change> &changes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = peers_.find(peer);
+  if (it == peers_.end()) {
+    return;
+  }
+  it->second.lastHeard = now;
+  it->second.answersKeepalives |= answersKeepalives;
+  setDownLocked(peer, it->second, false, changes);
+}
+
+void PeerLiveness::noteSessionState(CSteamID peer, bool connected, bool failed,
+                                    std::vector<Change> &changes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = peers_.find(peer);
+  if (it == peers_.end()) {
+    return;
+  }
+  if (failed) {
+    setDownLocked(peer, it->second, true, changes);
+  } else if (connected && !it->second.answersKeepalives) {
+    setDownLocked(peer, it->second, false, changes);
+  }
+}
+
+void PeerLiveness::tick(Clock::time_point now, std::vector<CSteamID> &probe,
+                        std::vector<Change> &changes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &[peer, state] : peers_) {
+    const auto silence = now - state.lastHeard;
+    if (silence >= kProbeAfter && now - state.lastProbe >= kProbeAfter) {
+      state.lastProbe = now;
+      probe.push_back(peer);
+    }
+    if (state.answersKeepalives && silence >= kDownAfter) {
+      setDownLocked(peer, state, true, changes);
+    }
+  }
+}
+
+bool PeerLiveness::isDown(CSteamID peer) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = peers_.find(peer);
+  return it != peers_.end() && it->second.down;
+}
+
+void PeerLiveness::setDownLocked(CSteamID peer, PeerState &state, bool down,
+                                 std::vector<Change> &changes) {
+  if (state.down == down) {
+    return;
+  }
+  state.down = down;
+  if (down) {
+    downCount_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    downCount_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  changes.push_back({peer, !down});
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <steam_api.h>
+#include <vector>
+
+// Per-peer reachability of the VPN data channel. A peer goes down as soon as
+// its Steam session fails, or once it has been silent for kDownAfter while it
+// is known to answer keepalives. Any later message brings it back up; peers
+// that predate keepalives come back when their session reconnects.
+class PeerLiveness {
+public:
+  using Clock = std::chrono::steady_clock;
+  // Silence before a keepalive request is sent (and repeated)
+  static constexpr std::chrono::milliseconds kProbeAfter{500};
+  static constexpr std::chrono::milliseconds kDownAfter{1500};
+
+  struct Change {
+    CSteamID peer;
+    bool up;
+  };
+
+  void track(CSteamID peer, Clock::time_point now);
+  void forget(CSteamID peer);
+  void clear();
+
+  // `answersKeepalives` is set for keepalive messages; it is never cleared.
+  void noteHeard(CSteamID peer, bool answersKeepalives, Clock::time_point now,
+                 std::vector<Change> &changes);
+  void noteSessionState(CSteamID peer, bool connected, bool failed,
+                        std::vector<Change> &changes);
+  // Collects silent peers due a keepalive request and marks keepalive-capable
+  // peers silent past kDownAfter as down.
+  void tick(Clock::time_point now, std::vector<CSteamID> &probe,
+            std::vector<Change> &changes);
+
+  bool isDown(CSteamID peer) const;
+  // Lets per-packet callers skip the lookup while every peer is up
+  bool anyDown() const { return downCount_.load(std::memory_order_relaxed); }
+
+private:
+  struct PeerState {
+    Clock::time_point lastHeard;
+    Clock::time_point lastProbe;
+    bool answersKeepalives = false;
+    bool down = false;
+  };
+
+  void setDownLocked(CSteamID peer, PeerState &state, bool down,
+                     std::vector<Change> &changes);
+
+  mutable std::mutex mutex_;
+  std::map<CSteamID, PeerState> peers_;
+  std::atomic<size_t> downCount_{0};
+};
@@ -0,0 +1,130 @@
+#include "send_budget.h"
+#include <algorithm>
+
+namespace {
+constexpr std::int64_t kHighWaterBytes = 512 * 1024;
+constexpr std::int64_t kLowWaterBytes = 256 * 1024;
+constexpr std::size_t kMinStreamCredit = 1100;
+// One Steam status query per cadence tick instead of one per chunk
+constexpr auto kSampleInterval = std::chrono::milliseconds(2);
+
+std::int64_t toMicros(std::chrono::steady_clock::time_point tp) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             tp.time_since_epoch())
+      .count();
+}
+} // namespace
+
+SendBudget::SendBudget(ISteamNetworkingSockets *steamInterface,
+                       HSteamNetConnection steamConn,
+                       boost::asio::io_context &io_context)
+    : steamInterface_(steamInterface), steamConn_(steamConn),
+      refillTimer_(std::make_unique<boost::asio::steady_timer>(io_context)),
+      credit_(kHighWaterBytes) {}
+
+SendBudget::~SendBudget() { refillTimer_->cancel(); }
+
+void SendBudget::setRefillCallback(std::function<void()> callback) {
+  refillCallback_ = std::move(callback);
+}
+
+bool SendBudget::tryConsume(std::size_t bytes) {
+  const auto now = std::chrono::steady_clock::now();
+  if (toMicros(now) - lastSampleUs_.load(std::memory_order_relaxed) >=
+      std::chrono::duration_cast<std::chrono::microseconds>(kSampleInterval)
+          .count()) {
+    sample(now);
+  }
+  if (exhausted_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  // Allow a single message to overshoot the high-water mark, as Steam does.
+  std::int64_t current = credit_.load(std::memory_order_relaxed);
+  do {
+    if (current <= 0) {
+      exhausted_.store(true, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!credit_.compare_exchange_weak(
+      current, current - static_cast<std::int64_t>(bytes),
+      std::memory_order_relaxed));
+  return true;
+}
+
+void SendBudget::markExhausted() {
+  credit_.store(0, std::memory_order_relaxed);
+  exhausted_.store(true, std::memory_order_relaxed);
+}
+
+std::size_t SendBudget::streamCredit(std::size_t activeStreams) const {
+  const std::int64_t credit =
+      std::max<std::int64_t>(credit_.load(std::memory_order_relaxed), 0);
+  const std::size_t share =
+      static_cast<std::size_t>(credit) / std::max<std::size_t>(activeStreams, 1);
+  return std::max(share, kMinStreamCredit);
+}
+
+void SendBudget::waitForRefill(std::shared_ptr<const void> owner) {
+  if (refillArmed_.exchange(true)) {
+    return;
+  }
+  boost::asio::post(refillTimer_->get_executor(),
+                    [this, owner = std::move(owner)]() mutable {
+                      armRefillTimer(std::move(owner));
+                    });
+}
+
+void SendBudget::cancel() {
+  cancelled_.store(true);
+  refillTimer_->cancel();
+}
+
+void SendBudget::armRefillTimer(std::shared_ptr<const void> owner) {
+  if (cancelled_.load()) {
+    refillArmed_.store(false);
+    return;
+  }
+  refillTimer_->expires_after(kSampleInterval);
+  refillTimer_->async_wait([this, owner](const boost::system::error_code &ec) {
+    if (ec || cancelled_.load()) {
+      refillArmed_.store(false);
+      return;
+    }
+    sample(std::chrono::steady_clock::now());
+    if (exhausted_.load(std::memory_order_relaxed)) {
+      armRefillTimer(owner);
+      return;
+    }
+    refillArmed_.store(false);
+    if (refillCallback_) {
+      refillCallback_();
+    }
+  });
+}
+
+void SendBudget::sample(std::chrono::steady_clock::time_point now) {
+  std::unique_lock<std::mutex> lock(sampleMutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return; // another thread is already refreshing the sample
+  }
+  lastSampleUs_.store(toMicros(now), std::memory_order_relaxed);
+
+  SteamNetConnectionRealTimeStatus_t status{};
+  if (steamInterface_->GetConnectionRealTimeStatus(steamConn_, &status, 0,
+                                                   nullptr) != k_EResultOK) {
+    return;
+  }
+  pingMs_.store(std::max(status.m_nPing, 0), std::memory_order_relaxed);
+  outBytesPerSec_.store(
+      static_cast<std::size_t>(std::max(status.m_flOutBytesPerSec, 0.0f)),
+      std::memory_order_relaxed);
+
+  // Steam's pending count now covers everything submitted before this point.
+  const std::int64_t pending = status.m_cbPendingReliable;
+  credit_.store(kHighWaterBytes - pending, std::memory_order_relaxed);
+  if (pending <= kLowWaterBytes) {
+    exhausted_.store(false, std::memory_order_relaxed);
+  } else if (pending >= kHighWaterBytes) {
+    exhausted_.store(true, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <boost/asio.hpp>
+#include <isteamnetworkingsockets.h>
+#include <steamnetworkingtypes.h>
+
+// Reliable-send budget for one Steam connection. Steam's pending-reliable
+// byte count is sampled on a fixed cadence and bytes submitted since the last
+// sample are charged against a local counter, so the send path never has to
+// query Steam per message.
+class SendBudget {
+public:
+    SendBudget(ISteamNetworkingSockets* steamInterface, HSteamNetConnection steamConn,
+               boost::asio::io_context& io_context);
+    ~SendBudget();
+
+    // Invoked on the io_context once an exhausted budget has refilled.
+    void setRefillCallback(std::function<void()> callback);
+
+    // Charges `bytes` against the budget; false when it is exhausted.
+    bool tryConsume(std::size_t bytes);
+    // Marks the budget exhausted after Steam itself refused a send.
+    void markExhausted();
+    // Credit granted to one of `activeStreams` streams sharing this connection.
+    std::size_t streamCredit(std::size_t activeStreams) const;
+    // Arms the cadence sampler; the refill callback fires once credit returns.
+    // `owner` (whatever embeds this budget) is kept alive until then.
+    void waitForRefill(std::shared_ptr<const void> owner);
+    // Drops a pending refill; its callback will not run.
+    void cancel();
+
+    int pingMs() const { return pingMs_.load(std::memory_order_relaxed); }
+    std::size_t outBytesPerSec() const { return outBytesPerSec_.load(std::memory_order_relaxed); }
+
+private:
+    void sample(std::chrono::steady_clock::time_point now);
+    void armRefillTimer(std::shared_ptr<const void> owner);
+
+    ISteamNetworkingSockets* steamInterface_;
+    HSteamNetConnection steamConn_;
+    std::unique_ptr<boost::asio::steady_timer> refillTimer_;
+    std::function<void()> refillCallback_;
+
+    std::atomic<std::int64_t> credit_;
+    std::atomic<bool> exhausted_{false};
+    std::atomic<bool> refillArmed_{false};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<int> pingMs_{0};
+    std::atomic<std::size_t> outBytesPerSec_{0};
+    std::atomic<std::int64_t> lastSampleUs_{0};
+    std::mutex sampleMutex_;
+};
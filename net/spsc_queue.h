@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded single-producer/single-consumer ring. push() is only ever called
+// from one thread and pop() from one other; neither side takes a lock.
+// Capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots_.reset(new T[size]);
+        mask_ = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    // Producer side. False when the ring is full.
+    bool push(const T& value) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ > mask_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ > mask_) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. False when the ring is empty.
+    bool pop(T& value) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_) {
+                return false;
+            }
+        }
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::unique_ptr<T[]> slots_;
+    std::size_t mask_ = 0;
+    // Each side owns one index and caches the other's to avoid bouncing the
+    // shared cache line on every operation.
+    alignas(64) std::atomic<std::size_t> head_{0};
+    std::size_t tailCache_ = 0;
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    std::size_t headCache_ = 0;
+};
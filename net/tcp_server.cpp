@@ -40,19 +40,6 @@ void TCPServer::stop() {
     acceptor_.close();
 }
 
-void TCPServer::sendToAll(const std::string& message, std::shared_ptr<tcp::socket> excludeSocket) {
-    sendToAll(message.c_str(), message.size(), excludeSocket);
-}
-
-void TCPServer::sendToAll(const char* data, size_t size, std::shared_ptr<tcp::socket> excludeSocket) {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    for (auto& client : clients_) {
-        if (client != excludeSocket) {
-            boost::asio::async_write(*client, boost::asio::buffer(data, size), [](const boost::system::error_code&, std::size_t) {});
-        }
-    }
-}
-
 int TCPServer::getClientCount() {
     std::lock_guard<std::mutex> lock(clientsMutex_);
     return clients_.size();
@@ -72,20 +59,23 @@ void TCPServer::start_accept() {
     auto socket = std::make_shared<tcp::socket>(io_context_);
     acceptor_.async_accept(*socket, [this, socket](const boost::system::error_code& error) {
         if (!error) {
-            std::cout << "New client connected" << std::endl;
-            // Low latency between local TCP and Steam tunnel
-            boost::system::error_code ec;
-            socket->set_option(tcp::no_delay(true), ec);
-            auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
-            std::string id = multiplexManager->addClient(socket);
-            int currentCount = 0;
-            {
-                std::lock_guard<std::mutex> lock(clientsMutex_);
-                clients_.push_back(socket);
-                currentCount = static_cast<int>(clients_.size());
+            if (!manager_->isConnected()) {
+                admitClient(socket, nullptr);
+            } else {
+                // Pinned to one stripe for its lifetime so its bytes stay
+                // ordered. The connection table lives on the handler's thread,
+                // so pick there and finish the accept back on ours.
+                std::weak_ptr<void> alive = alive_;
+                manager_->getMessageHandler()->leastLoadedManager(
+                    manager_->getTunnelStripes(),
+                    [this, alive, socket](std::shared_ptr<MultiplexManager> multiplexManager) {
+                        if (alive.lock()) {
+                            boost::asio::post(io_context_, [this, socket, multiplexManager]() {
+                                admitClient(socket, multiplexManager);
+                            });
+                        }
+                    });
             }
-            notifyClientCount(currentCount);
-            start_read(socket, id);
         }
         if (running_) {
             start_accept();
@@ -93,34 +83,41 @@ void TCPServer::start_accept() {
     });
 }
 
-void TCPServer::start_read(std::shared_ptr<tcp::socket> socket, std::string id) {
-    auto buffer = std::make_shared<std::vector<char>>(1048576);
-    socket->async_read_some(boost::asio::buffer(*buffer), [this, socket, buffer, id](const boost::system::error_code& error, std::size_t bytes_transferred) {
-        if (!error) {
-            if (manager_->isConnected()) {
-                auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
-                multiplexManager->sendTunnelPacket(id, buffer->data(), bytes_transferred, 0);
-            } else {
-                std::cout << "Not connected to Steam, skipping forward" << std::endl;
-            }
-            sendToAll(buffer->data(), bytes_transferred, socket);
-            start_read(socket, id);
-        } else {
-            std::cout << "TCP client " << id << " disconnected or error: " << error.message() << std::endl;
-            // Send disconnect packet
-            if (manager_->isConnected()) {
-                auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
-                multiplexManager->sendTunnelPacket(id, nullptr, 0, 1);
-                // Remove client
-                multiplexManager->removeClient(id);
-            }
-            int currentCount = 0;
-            {
-                std::lock_guard<std::mutex> lock(clientsMutex_);
-                clients_.erase(std::remove(clients_.begin(), clients_.end(), socket), clients_.end());
-                currentCount = static_cast<int>(clients_.size());
-            }
-            notifyClientCount(currentCount);
+void TCPServer::admitClient(const std::shared_ptr<tcp::socket>& socket,
+                            const std::shared_ptr<MultiplexManager>& multiplexManager) {
+    if (!multiplexManager) {
+        std::cout << "Not connected to Steam, rejecting client" << std::endl;
+        boost::system::error_code ec;
+        socket->close(ec);
+        return;
+    }
+    std::cout << "New client connected" << std::endl;
+    // Low latency between local TCP and Steam tunnel
+    boost::system::error_code ec;
+    socket->set_option(tcp::no_delay(true), ec);
+    int currentCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex_);
+        clients_.push_back(socket);
+        currentCount = static_cast<int>(clients_.size());
+    }
+    notifyClientCount(currentCount);
+    // The multiplexer owns the stream from here on: it reads the socket,
+    // forwards into the tunnel and reports the close.
+    std::weak_ptr<void> alive = alive_;
+    multiplexManager->addClient(socket, [this, alive, socket]() {
+        if (alive.lock()) {
+            onClientClosed(socket);
         }
     });
 }
+
+void TCPServer::onClientClosed(const std::shared_ptr<tcp::socket>& socket) {
+    int currentCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex_);
+        clients_.erase(std::remove(clients_.begin(), clients_.end(), socket), clients_.end());
+        currentCount = static_cast<int>(clients_.size());
+    }
+    notifyClientCount(currentCount);
+}
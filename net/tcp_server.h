@@ -25,14 +25,14 @@ public:
 
     bool start();
     void stop();
-    void sendToAll(const std::string& message, std::shared_ptr<tcp::socket> excludeSocket = nullptr);
-    void sendToAll(const char* data, size_t size, std::shared_ptr<tcp::socket> excludeSocket = nullptr);
     int getClientCount();
     void setClientCountCallback(std::function<void(int)> callback);
 
 private:
     void start_accept();
-    void start_read(std::shared_ptr<tcp::socket> socket, std::string id);
+    void admitClient(const std::shared_ptr<tcp::socket>& socket,
+                     const std::shared_ptr<MultiplexManager>& multiplexManager);
+    void onClientClosed(const std::shared_ptr<tcp::socket>& socket);
     void notifyClientCount(int count);
 
     int port_;
@@ -45,4 +45,6 @@ private:
     std::thread serverThread_;
     SteamNetworkingManager* manager_;
     std::function<void(int)> clientCountCallback_;
+    // Close callbacks handed to the multiplexer may outlive the server
+    std::shared_ptr<void> alive_ = std::make_shared<int>(0);
 };
@@ -0,0 +1,219 @@
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick) : tick_(tick) {
+  for (auto &level : heads_) {
+    level.fill(kNone);
+  }
+}
+
+TimerWheel::~TimerWheel() {
+  stop();
+  if (thread_.joinable()) {
+    if (thread_.get_id() == std::this_thread::get_id()) {
+      thread_.detach();
+    } else {
+      thread_.join();
+    }
+  }
+}
+
+void TimerWheel::start() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+      return;
+    }
+  }
+  // A wheel stopped from one of its own callbacks left its thread to exit
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  running_ = true;
+  // Timers scheduled since stop() already count from tick 0
+  now_ = 0;
+  startedAt_ = std::chrono::steady_clock::now();
+  thread_ = std::thread(&TimerWheel::run, this);
+}
+
+void TimerWheel::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  wake_.notify_all();
+  // From a callback the thread cannot join itself; it exits once the
+  // current batch of callbacks returns.
+  if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) {
+    thread_.join();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &level : heads_) {
+    level.fill(kNone);
+  }
+  freeNodes_.clear();
+  for (int32_t i = static_cast<int32_t>(nodes_.size()) - 1; i >= 0; --i) {
+    if (nodes_[i].level >= 0) {
+      nodes_[i].fn = nullptr;
+      nodes_[i].level = -1;
+      ++nodes_[i].generation;
+    }
+    freeNodes_.push_back(i);
+  }
+  now_ = 0;
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay,
+                                         std::function<void()> fn) {
+  const int64_t ticks =
+      delay.count() <= 0 ? 1
+                         : (delay.count() + tick_.count() - 1) / tick_.count();
+  std::lock_guard<std::mutex> lock(mutex_);
+  int32_t index;
+  if (!freeNodes_.empty()) {
+    index = freeNodes_.back();
+    freeNodes_.pop_back();
+  } else {
+    index = static_cast<int32_t>(nodes_.size());
+    nodes_.emplace_back();
+  }
+  Node &node = nodes_[index];
+  node.fn = std::move(fn);
+  node.expiry = now_ + static_cast<uint64_t>(ticks);
+  placeLocked(index);
+  // Generation 0 never appears in an id, so kInvalidTimer stays unused
+  return (static_cast<TimerId>(node.generation + 1) << 32) |
+         static_cast<uint32_t>(index);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+  if (id == kInvalidTimer) {
+    return false;
+  }
+  const int32_t index = static_cast<int32_t>(id & 0xFFFFFFFFu);
+  const uint32_t generation = static_cast<uint32_t>(id >> 32) - 1;
+  std::function<void()> dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index < 0 || index >= static_cast<int32_t>(nodes_.size()) ||
+        nodes_[index].level < 0 || nodes_[index].generation != generation) {
+      return false;
+    }
+    unlinkLocked(index);
+    dropped = std::move(nodes_[index].fn);
+    releaseLocked(index);
+  }
+  return true; // `dropped` is destroyed outside the lock
+}
+
+void TimerWheel::run() {
+  std::vector<std::function<void()>> due;
+  std::unique_lock<std::mutex> lock(mutex_);
+  const auto start = startedAt_;
+  while (running_) {
+    const auto deadline = start + tick_ * static_cast<int64_t>(now_ + 1);
+    if (wake_.wait_until(lock, deadline, [this] { return !running_; })) {
+      break;
+    }
+    // Catch up on every tick that elapsed, e.g. after a suspend
+    const auto now = std::chrono::steady_clock::now();
+    while (running_ && start + tick_ * static_cast<int64_t>(now_ + 1) <= now) {
+      advanceLocked(due);
+    }
+    if (due.empty()) {
+      continue;
+    }
+    lock.unlock();
+    for (auto &fn : due) {
+      fn();
+    }
+    due.clear();
+    lock.lock();
+  }
+}
+
+void TimerWheel::advanceLocked(std::vector<std::function<void()>> &due) {
+  ++now_;
+  // Pull the next block of each higher level down once the level below
+  // wraps; highest first so entries can fall through several levels.
+  int wrapped = 0;
+  while (wrapped + 1 < kLevels &&
+         (now_ & ((uint64_t(1) << (kSlotBits * (wrapped + 1))) - 1)) == 0) {
+    ++wrapped;
+  }
+  for (int level = wrapped; level >= 1; --level) {
+    const uint32_t slot =
+        static_cast<uint32_t>(now_ >> (kSlotBits * level)) & (kSlots - 1);
+    int32_t index = heads_[level][slot];
+    heads_[level][slot] = kNone;
+    while (index != kNone) {
+      const int32_t next = nodes_[index].next;
+      placeLocked(index);
+      index = next;
+    }
+  }
+
+  const uint32_t slot = static_cast<uint32_t>(now_) & (kSlots - 1);
+  int32_t index = heads_[0][slot];
+  heads_[0][slot] = kNone;
+  while (index != kNone) {
+    const int32_t next = nodes_[index].next;
+    if (nodes_[index].expiry <= now_) {
+      due.push_back(std::move(nodes_[index].fn));
+      releaseLocked(index);
+    } else {
+      placeLocked(index);
+    }
+    index = next;
+  }
+}
+
+void TimerWheel::placeLocked(int32_t index) {
+  Node &node = nodes_[index];
+  const uint64_t delta = node.expiry > now_ ? node.expiry - now_ : 0;
+  int level = 0;
+  while (level + 1 < kLevels &&
+         delta >= (uint64_t(1) << (kSlotBits * (level + 1)))) {
+    ++level;
+  }
+  uint64_t when = node.expiry;
+  if (delta >= (uint64_t(1) << (kSlotBits * kLevels))) {
+    // Too far out: park in the top level's last slot and re-cascade later
+    when = now_ + (uint64_t(1) << (kSlotBits * kLevels)) -
+           (uint64_t(1) << (kSlotBits * (kLevels - 1)));
+  }
+  const uint32_t slot =
+      static_cast<uint32_t>(when >> (kSlotBits * level)) & (kSlots - 1);
+  node.level = static_cast<int8_t>(level);
+  node.slot = static_cast<uint8_t>(slot);
+  node.prev = kNone;
+  node.next = heads_[level][slot];
+  if (node.next != kNone) {
+    nodes_[node.next].prev = index;
+  }
+  heads_[level][slot] = index;
+}
+
+void TimerWheel::unlinkLocked(int32_t index) {
+  Node &node = nodes_[index];
+  if (node.prev != kNone) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    heads_[node.level][node.slot] = node.next;
+  }
+  if (node.next != kNone) {
+    nodes_[node.next].prev = node.prev;
+  }
+  node.prev = node.next = kNone;
+}
+
+void TimerWheel::releaseLocked(int32_t index) {
+  Node &node = nodes_[index];
+  node.fn = nullptr;
+  node.level = -1;
+  ++node.generation;
+  freeNodes_.push_back(index);
+}
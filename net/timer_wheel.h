@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Hierarchical timing wheel (4 levels x 64 slots) driven by its own thread.
+// schedule() and cancel() are O(1); callbacks run on the wheel thread, outside
+// the wheel lock, so they may schedule or cancel further timers.
+class TimerWheel {
+public:
+  using TimerId = uint64_t;
+  static constexpr TimerId kInvalidTimer = 0;
+
+  explicit TimerWheel(
+      std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+  ~TimerWheel();
+
+  void start();
+  // Joins the thread and drops every pending timer without running it. Safe
+  // to call from a callback, in which case the thread exits on return.
+  void stop();
+
+  // Delays round up to whole ticks; anything beyond the top level (~46 h at
+  // the default tick) is re-cascaded until it is due.
+  TimerId schedule(std::chrono::milliseconds delay, std::function<void()> fn);
+  // False when the timer already fired, was cancelled, or never existed.
+  bool cancel(TimerId id);
+
+private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 6;
+  static constexpr uint32_t kSlots = 1u << kSlotBits;
+  static constexpr int32_t kNone = -1;
+
+  struct Node {
+    std::function<void()> fn;
+    uint64_t expiry = 0;
+    uint32_t generation = 0;
+    int32_t prev = kNone;
+    int32_t next = kNone;
+    int8_t level = -1; // -1: free
+    uint8_t slot = 0;
+  };
+
+  void run();
+  void advanceLocked(std::vector<std::function<void()>> &due);
+  void placeLocked(int32_t index);
+  void unlinkLocked(int32_t index);
+  void releaseLocked(int32_t index);
+
+  const std::chrono::milliseconds tick_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread thread_;
+  bool running_ = false;
+
+  // Both set by start() before the thread runs
+  uint64_t now_ = 0; // ticks since start()
+  std::chrono::steady_clock::time_point startedAt_;
+  std::vector<Node> nodes_;
+  std::vector<int32_t> freeNodes_;
+  std::array<std::array<int32_t, kSlots>, kLevels> heads_;
+};
@@ -0,0 +1,138 @@
+#include "udp_batch_io.h"
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+UdpBatchReceiver::UdpBatchReceiver(std::size_t headroom) : headroom_(headroom) {}
+
+std::size_t UdpBatchReceiver::drain(udp::socket& socket, boost::system::error_code& ec) {
+    ec.clear();
+    for (std::size_t i = 0; i < kMaxBatch; ++i) {
+        if (!slots_[i]) {
+            slots_[i] = BufferPool::shared().acquire(BufferPool::kLargeSlab);
+        }
+        iovs_[i].iov_base = slots_[i].data() + headroom_;
+        iovs_[i].iov_len = slots_[i].capacity() - headroom_;
+        std::memset(&msgs_[i], 0, sizeof(mmsghdr));
+        msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        msgs_[i].msg_hdr.msg_name = &addrs_[i];
+        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        msgs_[i].msg_hdr.msg_control = controls_[i].data;
+        msgs_[i].msg_hdr.msg_controllen = sizeof(controls_[i].data);
+    }
+    int received;
+    do {
+        received = ::recvmmsg(socket.native_handle(), msgs_.data(),
+                              static_cast<unsigned int>(kMaxBatch), MSG_DONTWAIT, nullptr);
+    } while (received < 0 && errno == EINTR);
+    if (received < 0) {
+        ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+        return 0;
+    }
+    return static_cast<std::size_t>(received);
+}
+
+udp::endpoint UdpBatchReceiver::source(std::size_t i) const {
+    udp::endpoint endpoint;
+    const std::size_t len = std::min<std::size_t>(msgs_[i].msg_hdr.msg_namelen, endpoint.capacity());
+    std::memcpy(endpoint.data(), &addrs_[i], len);
+    endpoint.resize(len);
+    return endpoint;
+}
+
+std::size_t UdpBatchReceiver::segmentSize(std::size_t i) const {
+    const msghdr& hdr = msgs_[i].msg_hdr;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int gsoSize = 0;
+            std::memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof(gsoSize));
+            return gsoSize > 0 && static_cast<std::size_t>(gsoSize) < msgs_[i].msg_len
+                       ? static_cast<std::size_t>(gsoSize)
+                       : 0;
+        }
+    }
+    return 0;
+}
+
+bool enableUdpGro(udp::socket& socket) {
+    const int on = 1;
+    return ::setsockopt(socket.native_handle(), SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+}
+
+bool sendUdpSegmented(udp::socket& socket, const udp::endpoint& to, const char* data, std::size_t len,
+                      std::size_t segmentSize) {
+    iovec iov;
+    iov.iov_base = const_cast<char*>(data);
+    iov.iov_len = len;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(std::uint16_t))] = {};
+    msghdr hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = const_cast<sockaddr*>(to.data());
+    hdr.msg_namelen = static_cast<socklen_t>(to.size());
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+    const std::uint16_t gsoSize = static_cast<std::uint16_t>(segmentSize);
+    std::memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof(gsoSize));
+
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(socket.native_handle(), &hdr, MSG_DONTWAIT);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(len);
+}
+
+std::size_t sendUdpBatch(udp::socket& socket, const UdpOutDatagram* datagrams, std::size_t count) {
+    constexpr std::size_t kMaxBatch = UdpBatchReceiver::kMaxBatch;
+    std::array<mmsghdr, kMaxBatch> msgs;
+    std::array<iovec, kMaxBatch> iovs;
+    std::size_t sent = 0;
+    while (sent < count) {
+        const std::size_t batch = std::min(kMaxBatch, count - sent);
+        for (std::size_t i = 0; i < batch; ++i) {
+            const UdpOutDatagram& out = datagrams[sent + i];
+            iovs[i].iov_base = const_cast<char*>(out.data);
+            iovs[i].iov_len = out.len;
+            std::memset(&msgs[i], 0, sizeof(mmsghdr));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = const_cast<sockaddr*>(out.to.data());
+            msgs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(out.to.size());
+        }
+        int accepted;
+        do {
+            accepted = ::sendmmsg(socket.native_handle(), msgs.data(),
+                                  static_cast<unsigned int>(batch), MSG_DONTWAIT);
+        } while (accepted < 0 && errno == EINTR);
+        if (accepted <= 0) {
+            break;
+        }
+        sent += static_cast<std::size_t>(accepted);
+        if (static_cast<std::size_t>(accepted) < batch) {
+            break;
+        }
+    }
+    return sent;
+}
+#endif
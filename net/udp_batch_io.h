@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <boost/asio.hpp>
+#include "buffer_pool.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <array>
+#endif
+
+using boost::asio::ip::udp;
+
+// One datagram queued for a batched send.
+struct UdpOutDatagram {
+    udp::endpoint to;
+    const char* data;
+    std::size_t len;
+};
+
+#ifdef __linux__
+// Drains a readable UDP socket with recvmmsg into pooled slabs, leaving
+// `headroom` bytes in front of each datagram for the tunnel header. The slabs
+// are scratch space reused by the next drain(); callers copy out what they
+// keep. One receiver serves every socket driven by the same thread.
+class UdpBatchReceiver {
+public:
+    static constexpr std::size_t kMaxBatch = 32;
+
+    explicit UdpBatchReceiver(std::size_t headroom);
+
+    // Receives whatever is already queued (up to kMaxBatch) without blocking.
+    // Returns the datagram count; 0 with ec == would_block when nothing was
+    // pending.
+    std::size_t drain(udp::socket& socket, boost::system::error_code& ec);
+
+    const char* data(std::size_t i) const { return slots_[i].data() + headroom_; }
+    std::size_t size(std::size_t i) const { return msgs_[i].msg_len; }
+    udp::endpoint source(std::size_t i) const;
+    // With UDP_GRO on, slot i may hold several coalesced datagrams of this
+    // size (the last one possibly shorter); 0 when it holds just one.
+    std::size_t segmentSize(std::size_t i) const;
+    // Start of slot i's headroom, writable until the next drain()
+    char* frame(std::size_t i) { return slots_[i].data(); }
+
+private:
+    std::size_t headroom_;
+    std::array<BufferLease, kMaxBatch> slots_;
+    std::array<mmsghdr, kMaxBatch> msgs_{};
+    std::array<iovec, kMaxBatch> iovs_{};
+    std::array<sockaddr_storage, kMaxBatch> addrs_{};
+    struct Control {
+        alignas(cmsghdr) char data[CMSG_SPACE(sizeof(int))];
+    };
+    std::array<Control, kMaxBatch> controls_{};
+};
+
+// Lets the kernel coalesce same-flow datagrams on receive (Linux 5.0+).
+bool enableUdpGro(udp::socket& socket);
+
+// Sends `len` bytes as back-to-back datagrams of `segmentSize` bytes in one
+// sendmsg with UDP_SEGMENT (Linux 4.18+). False if the kernel refused it; the
+// caller then sends the segments individually.
+bool sendUdpSegmented(udp::socket& socket, const udp::endpoint& to, const char* data, std::size_t len,
+                      std::size_t segmentSize);
+
+// Sends up to `count` datagrams with sendmmsg calls; returns how many the
+// kernel accepted before it would block or failed.
+std::size_t sendUdpBatch(udp::socket& socket, const UdpOutDatagram* datagrams, std::size_t count);
+#endif
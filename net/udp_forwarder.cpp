@@ -1,41 +1,110 @@
 #include "udp_forwarder.h"
 
 #include "../steam/steam_networking_manager.h"
+#include <isteamnetworkingutils.h>
+#include <algorithm>
 #include <random>
 #include <cstring>
 
 namespace {
-std::string generateUdpId() {
+UdpSessionId generateUdpId() {
     static const char chars[] =
         "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
     static thread_local std::mt19937 rng{std::random_device{}()};
     std::uniform_int_distribution<std::size_t> dist(0, sizeof(chars) - 2);
-    std::string id;
-    id.resize(6);
-    for (std::size_t i = 0; i < id.size(); ++i) {
+    char id[kUdpSessionIdBytes];
+    for (std::size_t i = 0; i < kUdpSessionIdBytes; ++i) {
         id[i] = chars[dist(rng)];
     }
-    return id;
+    return readSessionId(id);
 }
+
+constexpr char kUdpTunnelMarker = '\x02';
+// Marker byte plus session id in front of every tunneled datagram
+constexpr std::size_t kTunnelHeaderBytes = 1 + kUdpSessionIdBytes;
+// GRO-coalesced run of equal-size datagrams: header + uint16 segment size
+constexpr char kUdpSegmentedMarker = '\x04';
+constexpr std::size_t kSegmentedHeaderBytes = kTunnelHeaderBytes + sizeof(std::uint16_t);
+// Unreliable Steam messages are lost whole if one fragment drops; keep
+// coalesced runs to a few MTUs per message.
+constexpr std::size_t kMaxSegmentedMessageBytes = 8 * 1024;
+
+#ifdef __linux__
+using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
 } // namespace
 
 struct UDPForwarder::TargetSession {
     explicit TargetSession(boost::asio::io_context& context) : socket(context) {}
 
     udp::socket socket;
-    udp::endpoint remote;
-    std::array<char, 65536> buffer{};
     bool receiving = false;
+#ifndef __linux__
+    udp::endpoint remote;
+    BufferLease slab;
+#endif
+};
+
+struct UDPForwarder::Shard {
+    explicit Shard(std::size_t shardIndex)
+        : index(shardIndex),
+          work(boost::asio::make_work_guard(io)),
+          socket(io),
+          expiryTimer(io) {}
+
+    std::size_t index;
+    boost::asio::io_context io;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+    std::thread worker;
+    // Bind-port socket; every shard binds it with SO_REUSEPORT on Linux, so
+    // the kernel pins each client endpoint to one shard.
+    udp::socket socket;
+    bool receivesBindPort = false;
+#ifdef __linux__
+    std::unique_ptr<UdpBatchReceiver> batchReceiver;
+#else
+    udp::endpoint remoteEndpoint;
+    BufferLease recvSlab;
+#endif
+    std::vector<TunnelDatagram> tunnelBatch;
+    std::vector<ISteamNetworkingMessage*> steamBatch;
+
+    // Only contended by sessionStats() and the client count snapshot
+    std::mutex clientsMutex;
+    EndpointTable clientToId;
+    std::unordered_map<UdpSessionId, udp::endpoint> idToClient;
+    std::unordered_map<UdpSessionId, HSteamNetConnection> idToConn;
+    std::unordered_map<UdpSessionId, std::shared_ptr<TargetSession>> targetSessions;
+
+    // Idle expiry: sessions sit in the wheel slot of their deadline and are
+    // re-filed if they saw traffic since; the LRU list bounds the total.
+    boost::asio::steady_timer expiryTimer;
+    std::uint32_t nowTick = 0;
+    std::unordered_map<UdpSessionId, SessionActivity> sessionActivity;
+    std::list<UdpSessionId> lru;
+    std::array<std::vector<WheelEntry>, kWheelSlots> wheel;
+    std::vector<WheelEntry> expiring;
+
+    // Tunnel datagrams handed over by the Steam poll thread
+    std::mutex outboundMutex;
+    std::vector<OutboundDatagram> outbound;
+    bool outboundFlushPosted = false;
+    // Worker-thread scratch reused by every flush
+    std::vector<OutboundDatagram> draining;
+    std::vector<std::pair<udp::socket*, std::shared_ptr<TargetSession>>> flushSockets;
+    std::vector<UdpOutDatagram> flushBatch;
+    std::vector<ISteamNetworkingMessage*> flushMessages;
+    std::vector<std::size_t> flushSegments;
 };
 
 UDPForwarder::UDPForwarder(int bindPort,
                            int targetPort,
-                           SteamNetworkingManager* manager)
+                           SteamNetworkingManager* manager,
+                           std::size_t threads)
     : bindPort_(bindPort),
       targetPort_(targetPort),
+      threadCount_(std::max<std::size_t>(threads, 1)),
       running_(false),
-      work_(boost::asio::make_work_guard(io_context_)),
-      socket_(io_context_),
       manager_(manager) {}
 
 UDPForwarder::~UDPForwarder() {
@@ -44,234 +113,629 @@ UDPForwarder::~UDPForwarder() {
 
 bool UDPForwarder::start() {
     try {
-        udp::endpoint endpoint(udp::v4(), bindPort_);
-        socket_.open(endpoint.protocol());
-        socket_.bind(endpoint);
+        shards_.clear();
+        for (std::size_t i = 0; i < threadCount_; ++i) {
+            shards_.push_back(std::make_unique<Shard>(i));
+        }
+        const udp::endpoint endpoint(udp::v4(), bindPort_);
+        for (auto& shardPtr : shards_) {
+            Shard& shard = *shardPtr;
+#ifdef __linux__
+            // Only a fixed bind port can be shared; port 0 stays on shard 0
+            if (shard.index > 0 && bindPort_ <= 0) {
+                continue;
+            }
+            shard.socket.open(endpoint.protocol());
+            if (threadCount_ > 1) {
+                shard.socket.set_option(reuse_port(true));
+            }
+#else
+            // No kernel load balancing across sockets: shard 0 owns the port
+            if (shard.index > 0) {
+                continue;
+            }
+            shard.socket.open(endpoint.protocol());
+#endif
+            shard.socket.bind(endpoint);
+            shard.receivesBindPort = bindPort_ > 0;
+#ifdef __linux__
+            if (segmentOffload_ && shard.receivesBindPort) {
+                enableUdpGro(shard.socket);
+            }
+#endif
+        }
         running_ = true;
-        worker_ = std::thread([this]() { io_context_.run(); });
-        if (bindPort_ > 0) {
-            startReceive();
+        for (auto& shardPtr : shards_) {
+            Shard& shard = *shardPtr;
+#ifdef __linux__
+            shard.batchReceiver = std::make_unique<UdpBatchReceiver>(kTunnelHeaderBytes);
+#endif
+            shard.worker = std::thread([&shard]() { shard.io.run(); });
+            if (shard.receivesBindPort) {
+                startReceive(shard);
+            }
+            boost::asio::post(shard.io, [this, &shard]() { scheduleExpiryTick(shard); });
         }
         return true;
     } catch (const std::exception&) {
+        stop();
         return false;
     }
 }
 
 void UDPForwarder::stop() {
     running_ = false;
-    io_context_.stop();
-    if (worker_.joinable()) {
-        worker_.join();
+    // Close the sockets on each worker rather than stopping its io_context:
+    // pending sends then complete as aborted and release the Steam messages
+    // they hold, and queued flushes release theirs, before the worker exits.
+    for (auto& shardPtr : shards_) {
+        Shard& shard = *shardPtr;
+        boost::asio::post(shard.io, [&shard]() {
+            boost::system::error_code ec;
+            shard.socket.close(ec);
+            shard.expiryTimer.cancel();
+            std::lock_guard<std::mutex> lock(shard.clientsMutex);
+            for (auto& pair : shard.targetSessions) {
+                pair.second->socket.close(ec);
+            }
+        });
+        shard.work.reset();
     }
-    boost::system::error_code ec;
-    socket_.close(ec);
+    for (auto& shardPtr : shards_) {
+        Shard& shard = *shardPtr;
+        if (shard.worker.joinable()) {
+            shard.worker.join();
+        } else {
+            // No worker (start() failed early, or already stopped): drain here
+            shard.io.restart();
+            shard.io.run();
+        }
+
+        std::lock_guard<std::mutex> lock(shard.clientsMutex);
+        shard.targetSessions.clear();
+        shard.idToConn.clear();
+        shard.sessionActivity.clear();
+        shard.lru.clear();
+        for (auto& slot : shard.wheel) {
+            slot.clear();
+        }
+        std::lock_guard<std::mutex> outboundLock(shard.outboundMutex);
+        for (OutboundDatagram& datagram : shard.outbound) {
+            datagram.message->Release();
+        }
+        shard.outbound.clear();
+    }
+}
 
+void UDPForwarder::setSegmentOffload(bool enabled) {
+    segmentOffload_ = enabled;
+}
+
+std::size_t UDPForwarder::shardFor(UdpSessionId id) const {
+    // Fibonacci hashing of the packed id; ids are drawn so that the shard
+    // that created a session also owns it.
+    return static_cast<std::size_t>((id * 0x9E3779B97F4A7C15ULL) >> 32) % threadCount_;
+}
+
+void UDPForwarder::setSessionLimits(std::chrono::seconds idleTtl, std::size_t maxSessions) {
+    idleTtlTicks_ = static_cast<std::uint32_t>(std::max<std::int64_t>(idleTtl.count(), 1));
+    maxSessions = std::max<std::size_t>(maxSessions, 1);
+    maxSessionsPerShard_ = std::max<std::size_t>((maxSessions + threadCount_ - 1) / threadCount_, 1);
+}
+
+UDPForwarder::SessionStats UDPForwarder::sessionStats() {
+    SessionStats stats;
+    stats.created = sessionsCreated_.load(std::memory_order_relaxed);
+    stats.expired = sessionsExpired_.load(std::memory_order_relaxed);
+    stats.evicted = sessionsEvicted_.load(std::memory_order_relaxed);
+    for (auto& shardPtr : shards_) {
+        std::lock_guard<std::mutex> lock(shardPtr->clientsMutex);
+        stats.active += shardPtr->sessionActivity.size();
+    }
+    return stats;
+}
+
+void UDPForwarder::touchSessionLocked(Shard& shard, UdpSessionId id) {
+    auto it = shard.sessionActivity.find(id);
+    if (it != shard.sessionActivity.end()) {
+        it->second.lastTick = shard.nowTick;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPos);
+        return;
+    }
+    // New session: make room first, then track it on the wheel and LRU
+    while (shard.sessionActivity.size() >= maxSessionsPerShard_ && !shard.lru.empty()) {
+        removeSessionLocked(shard, shard.lru.back());
+        sessionsEvicted_.fetch_add(1, std::memory_order_relaxed);
+    }
+    const std::uint64_t generation = sessionsCreated_.fetch_add(1, std::memory_order_relaxed);
+    shard.lru.push_front(id);
+    shard.sessionActivity[id] = SessionActivity{shard.nowTick, generation, shard.lru.begin()};
+    shard.wheel[(shard.nowTick + idleTtlTicks_) % kWheelSlots].push_back(WheelEntry{id, generation});
+}
+
+void UDPForwarder::removeSessionLocked(Shard& shard, UdpSessionId id) {
+    auto activity = shard.sessionActivity.find(id);
+    if (activity != shard.sessionActivity.end()) {
+        shard.lru.erase(activity->second.lruPos);
+        shard.sessionActivity.erase(activity);
+    }
+    auto client = shard.idToClient.find(id);
+    if (client != shard.idToClient.end()) {
+        shard.clientToId.erase(EndpointKey::from(client->second));
+        shard.idToClient.erase(client);
+        clientCount_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    auto target = shard.targetSessions.find(id);
+    if (target != shard.targetSessions.end()) {
+        boost::system::error_code ignored;
+        target->second->socket.close(ignored);
+        shard.targetSessions.erase(target);
+    }
+    shard.idToConn.erase(id);
+}
+
+void UDPForwarder::scheduleExpiryTick(Shard& shard) {
+    if (!running_) {
+        return;
+    }
+    shard.expiryTimer.expires_after(kWheelTick);
+    shard.expiryTimer.async_wait([this, &shard](const boost::system::error_code& ec) {
+        if (ec || !running_) {
+            return;
+        }
+        expireIdleSessions(shard);
+        scheduleExpiryTick(shard);
+    });
+}
+
+void UDPForwarder::expireIdleSessions(Shard& shard) {
+    bool clientsChanged = false;
     {
-        std::lock_guard<std::mutex> lock(clientsMutex_);
-        for (auto& pair : targetSessions_) {
-            boost::system::error_code ignored;
-            pair.second->socket.close(ignored);
+        std::lock_guard<std::mutex> lock(shard.clientsMutex);
+        ++shard.nowTick;
+        auto& slot = shard.wheel[shard.nowTick % kWheelSlots];
+        shard.expiring.swap(slot);
+        for (const WheelEntry& entry : shard.expiring) {
+            const UdpSessionId id = entry.id;
+            auto it = shard.sessionActivity.find(id);
+            if (it == shard.sessionActivity.end() || it->second.generation != entry.generation) {
+                continue; // evicted (and possibly recreated) since it was filed
+            }
+            const std::uint32_t deadline = it->second.lastTick + idleTtlTicks_;
+            if (static_cast<std::int32_t>(deadline - shard.nowTick) > 0) {
+                // Active since it was scheduled: revisit at its new deadline
+                shard.wheel[deadline % kWheelSlots].push_back(entry);
+                continue;
+            }
+            clientsChanged = clientsChanged || shard.idToClient.count(id) != 0;
+            removeSessionLocked(shard, id);
+            sessionsExpired_.fetch_add(1, std::memory_order_relaxed);
         }
-        targetSessions_.clear();
-        idToConn_.clear();
+        shard.expiring.clear();
+    }
+    if (clientsChanged) {
+        notifyClientCount();
     }
 }
 
 int UDPForwarder::getClientCount() {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    return static_cast<int>(clientToId_.size());
+    return clientCount_.load(std::memory_order_relaxed);
 }
 
 void UDPForwarder::setClientCountCallback(std::function<void(int)> callback) {
     clientCountCallback_ = std::move(callback);
 }
 
-void UDPForwarder::notifyClientCount(int count) {
+void UDPForwarder::notifyClientCount() {
     if (clientCountCallback_) {
-        clientCountCallback_(count);
+        clientCountCallback_(clientCount_.load(std::memory_order_relaxed));
     }
 }
 
-void UDPForwarder::startReceive() {
-    socket_.async_receive_from(
-        boost::asio::buffer(recvBuffer_), remoteEndpoint_,
-        [this](const boost::system::error_code& ec, std::size_t bytes) {
-            if (!ec && bytes > 0 && manager_) {
-                ClientKey key{remoteEndpoint_};
-                std::string id;
-                bool added = false;
-                {
-                    std::lock_guard<std::mutex> lock(clientsMutex_);
-                    auto it = clientToId_.find(key);
-                    if (it == clientToId_.end()) {
-                        id = generateUdpId();
-                        clientToId_[key] = id;
-                        idToClient_[id] = key;
-                        added = true;
-                    } else {
-                        id = it->second;
+UdpSessionId UDPForwarder::sessionForEndpoint(Shard& shard, const udp::endpoint& endpoint) {
+    const EndpointKey key = EndpointKey::from(endpoint);
+    UdpSessionId id = 0;
+    {
+        std::lock_guard<std::mutex> lock(shard.clientsMutex);
+        if (const UdpSessionId* existing = shard.clientToId.find(key)) {
+            touchSessionLocked(shard, *existing);
+            return *existing;
+        }
+        // Draw ids until one hashes to this shard, so replies coming back
+        // through the tunnel land on the thread that owns the client.
+        do {
+            id = generateUdpId();
+        } while (shardFor(id) != shard.index || shard.idToClient.count(id) != 0);
+        touchSessionLocked(shard, id);
+        shard.clientToId.insert(key, id);
+        shard.idToClient[id] = endpoint;
+        clientCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+    notifyClientCount();
+    return id;
+}
+
+#ifdef __linux__
+void UDPForwarder::startReceive(Shard& shard) {
+    // Wait for readability, then drain everything queued with recvmmsg and
+    // hand it to Steam as one batch.
+    shard.socket.async_wait(udp::socket::wait_read, [this, &shard](const boost::system::error_code& ec) {
+        if (ec || !running_) {
+            return;
+        }
+        std::size_t received = 0;
+        do {
+            boost::system::error_code recvEc;
+            received = shard.batchReceiver->drain(shard.socket, recvEc);
+            if (manager_ && received > 0) {
+                shard.tunnelBatch.clear();
+                for (std::size_t i = 0; i < received; ++i) {
+                    if (shard.batchReceiver->size(i) == 0) {
+                        continue;
                     }
+                    const UdpSessionId id = sessionForEndpoint(shard, shard.batchReceiver->source(i));
+                    const std::size_t segmentSize = shard.batchReceiver->segmentSize(i);
+                    shard.tunnelBatch.push_back(TunnelDatagram{id, shard.batchReceiver->data(i),
+                                                               shard.batchReceiver->size(i),
+                                                               shard.batchReceiver->frame(i), segmentSize});
                 }
-                if (added) {
-                    notifyClientCount(static_cast<int>(clientToId_.size()));
+                sendTunnelBatch(shard, shard.tunnelBatch.data(), shard.tunnelBatch.size());
+            }
+        } while (received == UdpBatchReceiver::kMaxBatch && running_);
+        if (running_) {
+            startReceive(shard);
+        }
+    });
+}
+
+void UDPForwarder::startTargetReceive(Shard& shard, UdpSessionId id, const std::shared_ptr<TargetSession>& session) {
+    if (!running_ || !session) {
+        if (session) {
+            session->receiving = false;
+        }
+        return;
+    }
+    session->socket.async_wait(udp::socket::wait_read, [this, &shard, id, session](const boost::system::error_code& ec) {
+        if (ec || !running_) {
+            session->receiving = false;
+            return;
+        }
+        std::size_t received = 0;
+        do {
+            boost::system::error_code recvEc;
+            received = shard.batchReceiver->drain(session->socket, recvEc);
+            if (received > 0) {
+                std::lock_guard<std::mutex> lock(shard.clientsMutex);
+                touchSessionLocked(shard, id);
+            }
+            shard.tunnelBatch.clear();
+            for (std::size_t i = 0; i < received; ++i) {
+                if (shard.batchReceiver->size(i) > 0) {
+                    const std::size_t segmentSize = shard.batchReceiver->segmentSize(i);
+                    shard.tunnelBatch.push_back(TunnelDatagram{id, shard.batchReceiver->data(i),
+                                                               shard.batchReceiver->size(i),
+                                                               shard.batchReceiver->frame(i), segmentSize});
                 }
-                sendTunnelPacket(id, recvBuffer_.data(), bytes);
+            }
+            sendTunnelBatch(shard, shard.tunnelBatch.data(), shard.tunnelBatch.size());
+        } while (received == UdpBatchReceiver::kMaxBatch && running_);
+        startTargetReceive(shard, id, session);
+    });
+}
+#else
+void UDPForwarder::startReceive(Shard& shard) {
+    if (!shard.recvSlab) {
+        shard.recvSlab = BufferPool::shared().acquire(BufferPool::kLargeSlab);
+    }
+    shard.socket.async_receive_from(
+        boost::asio::buffer(shard.recvSlab.data() + kTunnelHeaderBytes, shard.recvSlab.capacity() - kTunnelHeaderBytes),
+        shard.remoteEndpoint,
+        [this, &shard](const boost::system::error_code& ec, std::size_t bytes) {
+            if (!ec && bytes > 0 && manager_) {
+                TunnelDatagram datagram{sessionForEndpoint(shard, shard.remoteEndpoint), shard.recvSlab.data() + kTunnelHeaderBytes,
+                                        bytes, shard.recvSlab.data()};
+                sendTunnelBatch(shard, &datagram, 1);
             }
             if (running_) {
-                startReceive();
+                startReceive(shard);
             }
         });
 }
 
-void UDPForwarder::startTargetReceive(const std::string& id, const std::shared_ptr<TargetSession>& session) {
+void UDPForwarder::startTargetReceive(Shard& shard, UdpSessionId id, const std::shared_ptr<TargetSession>& session) {
     if (!running_ || !session) {
         if (session) {
             session->receiving = false;
         }
         return;
     }
+    if (!session->slab) {
+        session->slab = BufferPool::shared().acquire(BufferPool::kLargeSlab);
+    }
     session->socket.async_receive_from(
-        boost::asio::buffer(session->buffer), session->remote,
-        [this, id, session](const boost::system::error_code& ec, std::size_t bytes) {
+        boost::asio::buffer(session->slab.data() + kTunnelHeaderBytes, session->slab.capacity() - kTunnelHeaderBytes),
+        session->remote,
+        [this, &shard, id, session](const boost::system::error_code& ec, std::size_t bytes) {
             if (ec || !running_) {
                 session->receiving = false;
                 return;
             }
             if (bytes > 0) {
-                sendTunnelPacket(id, session->buffer.data(), bytes);
+                {
+                    std::lock_guard<std::mutex> lock(shard.clientsMutex);
+                    touchSessionLocked(shard, id);
+                }
+                TunnelDatagram datagram{id, session->slab.data() + kTunnelHeaderBytes, bytes, session->slab.data()};
+                sendTunnelBatch(shard, &datagram, 1);
             }
-            startTargetReceive(id, session);
+            startTargetReceive(shard, id, session);
         });
 }
+#endif
 
-void UDPForwarder::sendTunnelPacket(const std::string& id,
-                                    const char* data,
-                                    size_t len) {
-    if (!manager_ || !manager_->isConnected()) {
+void UDPForwarder::sendTunnelBatch(Shard& shard, TunnelDatagram* datagrams, std::size_t count) {
+    if (count == 0 || !manager_ || !manager_->isConnected()) {
         return;
     }
     ISteamNetworkingSockets* interfacePtr = manager_->getInterface();
     if (!interfacePtr) {
         return;
     }
+    ISteamNetworkingUtils* utils = SteamNetworkingUtils();
+    const bool isHost = manager_->isHost();
+    const HSteamNetConnection clientConn = isHost ? k_HSteamNetConnection_Invalid : manager_->getConnection();
+    constexpr int kSendFlags = k_nSteamNetworkingSend_UnreliableNoNagle | k_nSteamNetworkingSend_NoDelay;
 
-    std::vector<char> packet;
-    packet.reserve(1 + 6 + len);
-    packet.push_back('\x02');
-
-    char idBuf[6] = {};
-    if (!id.empty()) {
-        const std::size_t copyLen = std::min<std::size_t>(6, id.size());
-        std::memcpy(idBuf, id.data(), copyLen);
-    }
-    packet.insert(packet.end(), idBuf, idBuf + 6);
-    packet.insert(packet.end(), data, data + len);
+    shard.steamBatch.clear();
+    for (std::size_t i = 0; i < count; ++i) {
+        TunnelDatagram& datagram = datagrams[i];
+        HSteamNetConnection targetConn = clientConn;
+        if (isHost) {
+            std::lock_guard<std::mutex> lock(shard.clientsMutex);
+            auto it = shard.idToConn.find(datagram.id);
+            targetConn = it != shard.idToConn.end() ? it->second : k_HSteamNetConnection_Invalid;
+        }
+        if (targetConn == k_HSteamNetConnection_Invalid) {
+            continue;
+        }
+        if (datagram.segmentSize > 0) {
+            appendSegmentedMessages(shard, interfacePtr, utils, targetConn, datagram);
+            continue;
+        }
 
-    if (manager_->isHost()) {
-        HSteamNetConnection targetConn = k_HSteamNetConnection_Invalid;
-        {
-            std::lock_guard<std::mutex> lock(clientsMutex_);
-            auto it = idToConn_.find(id);
-            if (it != idToConn_.end()) {
-                targetConn = it->second;
+        const std::size_t packetSize = kTunnelHeaderBytes + datagram.len;
+        if (!utils) {
+            // No message allocator: frame in place if possible and let Steam copy
+            std::vector<char> copy;
+            char* packet = datagram.frame;
+            if (!packet) {
+                copy.resize(packetSize);
+                packet = copy.data();
+                std::memcpy(packet + kTunnelHeaderBytes, datagram.data, datagram.len);
             }
+            packet[0] = kUdpTunnelMarker;
+            writeSessionId(datagram.id, packet + 1);
+            interfacePtr->SendMessageToConnection(targetConn, packet, static_cast<uint32>(packetSize), kSendFlags,
+                                                  nullptr);
+            continue;
         }
-        if (targetConn == k_HSteamNetConnection_Invalid) {
-            return;
+
+        // Copy into a message sized to the datagram: lending the receive slab
+        // would pin a whole 64 KiB buffer per packet until Steam sends it.
+        ISteamNetworkingMessage* message = utils->AllocateMessage(static_cast<int>(packetSize));
+        if (!message) {
+            continue;
         }
-        interfacePtr->SendMessageToConnection(
-            targetConn,
-            packet.data(),
-            static_cast<uint32>(packet.size()),
-            k_nSteamNetworkingSend_UnreliableNoNagle |
-                k_nSteamNetworkingSend_NoDelay,
-            nullptr);
-        return;
+        char* packet = static_cast<char*>(message->m_pData);
+        packet[0] = kUdpTunnelMarker;
+        writeSessionId(datagram.id, packet + 1);
+        std::memcpy(packet + kTunnelHeaderBytes, datagram.data, datagram.len);
+        message->m_conn = targetConn;
+        message->m_nFlags = kSendFlags;
+        shard.steamBatch.push_back(message);
+    }
+    if (!shard.steamBatch.empty()) {
+        interfacePtr->SendMessages(static_cast<int>(shard.steamBatch.size()), shard.steamBatch.data(), nullptr);
+        shard.steamBatch.clear();
     }
+}
 
-    const HSteamNetConnection conn = manager_->getConnection();
-    if (conn == k_HSteamNetConnection_Invalid) {
-        return;
+void UDPForwarder::appendSegmentedMessages(Shard& shard, ISteamNetworkingSockets* interfacePtr,
+                                           ISteamNetworkingUtils* utils, HSteamNetConnection targetConn,
+                                           const TunnelDatagram& datagram) {
+    constexpr int kSendFlags = k_nSteamNetworkingSend_UnreliableNoNagle | k_nSteamNetworkingSend_NoDelay;
+    const std::size_t segmentSize = datagram.segmentSize;
+    // Whole segments only, so the far side can cut each message evenly
+    const std::size_t perMessage =
+        std::max<std::size_t>(kMaxSegmentedMessageBytes / segmentSize, 1) * segmentSize;
+    const std::uint16_t segmentSize16 = static_cast<std::uint16_t>(segmentSize);
+    for (std::size_t offset = 0; offset < datagram.len; offset += perMessage) {
+        const std::size_t chunk = std::min(perMessage, datagram.len - offset);
+        const std::size_t packetSize = kSegmentedHeaderBytes + chunk;
+        ISteamNetworkingMessage* message = utils ? utils->AllocateMessage(static_cast<int>(packetSize)) : nullptr;
+        std::vector<char> copy;
+        char* packet = nullptr;
+        if (message) {
+            packet = static_cast<char*>(message->m_pData);
+        } else {
+            copy.resize(packetSize);
+            packet = copy.data();
+        }
+        packet[0] = kUdpSegmentedMarker;
+        writeSessionId(datagram.id, packet + 1);
+        std::memcpy(packet + kTunnelHeaderBytes, &segmentSize16, sizeof(segmentSize16));
+        std::memcpy(packet + kSegmentedHeaderBytes, datagram.data + offset, chunk);
+        if (message) {
+            message->m_conn = targetConn;
+            message->m_nFlags = kSendFlags;
+            shard.steamBatch.push_back(message);
+        } else {
+            interfacePtr->SendMessageToConnection(targetConn, packet, static_cast<uint32>(packetSize), kSendFlags,
+                                                  nullptr);
+        }
     }
-    interfacePtr->SendMessageToConnection(
-        conn,
-        packet.data(),
-        static_cast<uint32>(packet.size()),
-        k_nSteamNetworkingSend_UnreliableNoNagle |
-            k_nSteamNetworkingSend_NoDelay,
-        nullptr);
 }
 
-void UDPForwarder::handleTunnelPacket(HSteamNetConnection conn, const char* data, size_t len) {
-    if (len < 6) {
+void UDPForwarder::handleTunnelMessage(HSteamNetConnection conn, ISteamNetworkingMessage* message) {
+    const char* data = static_cast<const char*>(message->m_pData);
+    const std::size_t size = static_cast<std::size_t>(message->m_cbSize);
+    const bool segmented = size > 0 && data[0] == kUdpSegmentedMarker;
+    const std::size_t headerBytes = segmented ? kSegmentedHeaderBytes : kTunnelHeaderBytes;
+    if (size < headerBytes || !running_ || shards_.empty()) {
+        message->Release();
         return;
     }
+    std::uint16_t segmentSize = 0;
+    if (segmented) {
+        std::memcpy(&segmentSize, data + kTunnelHeaderBytes, sizeof(segmentSize));
+    }
 
-    std::string id(data, 6);
-    auto payload = std::make_shared<std::vector<char>>(data + 6, data + len);
+    const UdpSessionId id = readSessionId(data + 1);
+    Shard& shard = *shards_[shardFor(id)];
+    bool postFlush = false;
+    {
+        std::lock_guard<std::mutex> lock(shard.outboundMutex);
+        shard.outbound.push_back(OutboundDatagram{id, conn, message, data + headerBytes, size - headerBytes,
+                                                  segmentSize});
+        if (!shard.outboundFlushPosted) {
+            shard.outboundFlushPosted = true;
+            postFlush = true;
+        }
+    }
+    // Everything that arrives before the worker runs leaves in one flush
+    if (postFlush) {
+        boost::asio::post(shard.io, [this, &shard]() { flushOutbound(shard); });
+    }
+}
 
-    boost::asio::post(io_context_, [this, conn, id = std::move(id), payload]() {
-        if (!running_ || !manager_) {
-            return;
+void UDPForwarder::flushOutbound(Shard& shard) {
+    {
+        std::lock_guard<std::mutex> lock(shard.outboundMutex);
+        shard.draining.swap(shard.outbound);
+        shard.outboundFlushPosted = false;
+    }
+    if (!running_ || !manager_) {
+        for (OutboundDatagram& datagram : shard.draining) {
+            datagram.message->Release();
         }
+        shard.draining.clear();
+        return;
+    }
 
-        if (manager_->isHost()) {
-            if (conn == k_HSteamNetConnection_Invalid) {
-                return;
+    const bool isHost = manager_->isHost();
+    const udp::endpoint targetEndpoint(boost::asio::ip::address_v4::loopback(),
+                                       static_cast<unsigned short>(targetPort_));
+    // Resolve each datagram to its socket; runs of the same socket go out
+    // together, straight from the Steam message payloads.
+    shard.flushSockets.clear();
+    shard.flushBatch.clear();
+    shard.flushMessages.clear();
+    shard.flushSegments.clear();
+    for (OutboundDatagram& datagram : shard.draining) {
+        if (isHost) {
+            if (datagram.conn == k_HSteamNetConnection_Invalid) {
+                datagram.message->Release();
+                continue;
             }
-
             std::shared_ptr<TargetSession> session;
             {
-                std::lock_guard<std::mutex> lock(clientsMutex_);
-                idToConn_[id] = conn;
-                auto it = targetSessions_.find(id);
-                if (it != targetSessions_.end()) {
+                std::lock_guard<std::mutex> lock(shard.clientsMutex);
+                touchSessionLocked(shard, datagram.id);
+                shard.idToConn[datagram.id] = datagram.conn;
+                auto it = shard.targetSessions.find(datagram.id);
+                if (it != shard.targetSessions.end()) {
                     session = it->second;
                 } else {
-                    session = std::make_shared<TargetSession>(io_context_);
+                    session = std::make_shared<TargetSession>(shard.io);
                     session->socket.open(udp::v4());
                     session->socket.bind(udp::endpoint(udp::v4(), 0));
-                    targetSessions_[id] = session;
+#ifdef __linux__
+                    if (segmentOffload_) {
+                        enableUdpGro(session->socket);
+                    }
+#endif
+                    shard.targetSessions[datagram.id] = session;
                 }
             }
-
-            if (session && !session->receiving) {
+            if (!session->receiving) {
                 session->receiving = true;
-                startTargetReceive(id, session);
+                startTargetReceive(shard, datagram.id, session);
             }
-
-            const udp::endpoint targetEndpoint(
-                boost::asio::ip::address_v4::loopback(),
-                static_cast<unsigned short>(targetPort_));
-
-            if (!session) {
-                return;
+            shard.flushSockets.emplace_back(&session->socket, std::move(session));
+            shard.flushBatch.push_back(UdpOutDatagram{targetEndpoint, datagram.data, datagram.len});
+        } else {
+            udp::endpoint endpoint;
+            {
+                std::lock_guard<std::mutex> lock(shard.clientsMutex);
+                auto it = shard.idToClient.find(datagram.id);
+                if (it == shard.idToClient.end()) {
+                    datagram.message->Release();
+                    continue;
+                }
+                endpoint = it->second;
+                touchSessionLocked(shard, datagram.id);
             }
-
-            session->socket.async_send_to(
-                boost::asio::buffer(*payload), targetEndpoint,
-                [payload](const boost::system::error_code&, std::size_t) {});
-            return;
+            shard.flushSockets.emplace_back(&shard.socket, nullptr);
+            shard.flushBatch.push_back(UdpOutDatagram{endpoint, datagram.data, datagram.len});
         }
+        shard.flushMessages.push_back(datagram.message);
+        shard.flushSegments.push_back(datagram.segmentSize < datagram.len ? datagram.segmentSize : 0);
+    }
+    shard.draining.clear();
 
-        udp::endpoint endpoint;
-        bool found = false;
-        ClientKey key;
-        {
-            std::lock_guard<std::mutex> lock(clientsMutex_);
-            auto it = idToClient_.find(id);
-            if (it != idToClient_.end()) {
-                key = it->second;
-                found = true;
-            }
+    std::size_t begin = 0;
+    while (begin < shard.flushBatch.size()) {
+        udp::socket* socket = shard.flushSockets[begin].first;
+        if (shard.flushSegments[begin] > 0) {
+            sendSegmentedLocal(shard, begin);
+            ++begin;
+            continue;
         }
-        if (!found) {
-            return;
+        std::size_t end = begin + 1;
+        while (end < shard.flushBatch.size() && shard.flushSockets[end].first == socket &&
+               shard.flushSegments[end] == 0) {
+            ++end;
         }
-        endpoint = key.endpoint;
-        socket_.async_send_to(
-            boost::asio::buffer(*payload), endpoint,
-            [payload](const boost::system::error_code&, std::size_t) {});
-    });
+        std::size_t sent = 0;
+#ifdef __linux__
+        sent = sendUdpBatch(*socket, shard.flushBatch.data() + begin, end - begin);
+#endif
+        for (std::size_t i = begin; i < begin + sent; ++i) {
+            shard.flushMessages[i]->Release();
+        }
+        // Portable path, and whatever the kernel would not take right now;
+        // the message is released once its send completes.
+        for (std::size_t i = begin + sent; i < end; ++i) {
+            ISteamNetworkingMessage* message = shard.flushMessages[i];
+            auto session = shard.flushSockets[i].second;
+            socket->async_send_to(boost::asio::buffer(shard.flushBatch[i].data, shard.flushBatch[i].len), shard.flushBatch[i].to,
+                                  [message, session](const boost::system::error_code&, std::size_t) {
+                                      message->Release();
+                                  });
+        }
+        begin = end;
+    }
+    shard.flushSockets.clear();
+}
+
+void UDPForwarder::sendSegmentedLocal(Shard& shard, std::size_t index) {
+    udp::socket& socket = *shard.flushSockets[index].first;
+    const UdpOutDatagram& out = shard.flushBatch[index];
+    ISteamNetworkingMessage* message = shard.flushMessages[index];
+    const std::size_t segmentSize = shard.flushSegments[index];
+#ifdef __linux__
+    // One syscall; the kernel cuts the run back into datagrams
+    if (sendUdpSegmented(socket, out.to, out.data, out.len, segmentSize)) {
+        message->Release();
+        return;
+    }
+#endif
+    // Re-segment by hand; the message goes once the last send completes
+    std::shared_ptr<ISteamNetworkingMessage> holder(message, [](ISteamNetworkingMessage* m) { m->Release(); });
+    auto session = shard.flushSockets[index].second;
+    for (std::size_t offset = 0; offset < out.len; offset += segmentSize) {
+        const std::size_t len = std::min(segmentSize, out.len - offset);
+        socket.async_send_to(boost::asio::buffer(out.data + offset, len), out.to,
+                             [holder, session](const boost::system::error_code&, std::size_t) {});
+    }
 }
@@ -1,16 +1,24 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <functional>
-#include <map>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <isteamnetworkingsockets.h>
+#include <isteamnetworkingutils.h>
 #include <steamnetworkingtypes.h>
+#include "endpoint_table.h"
+#include "udp_batch_io.h"
 
 class SteamNetworkingManager;
 
@@ -18,9 +26,12 @@ using boost::asio::ip::udp;
 
 class UDPForwarder {
 public:
+    // `threads` shards run their own io_context. Each session id belongs to
+    // exactly one shard, so a session's state is only touched by its thread.
     UDPForwarder(int bindPort,
                  int targetPort,
-                 SteamNetworkingManager* manager);
+                 SteamNetworkingManager* manager,
+                 std::size_t threads = 1);
     ~UDPForwarder();
 
     bool start();
@@ -29,41 +40,92 @@ public:
     int getClientCount();
     void setClientCountCallback(std::function<void(int)> callback);
 
-    void handleTunnelPacket(HSteamNetConnection conn, const char* data, size_t len);
+    // Sessions idle for `idleTtl` are expired; beyond `maxSessions` the least
+    // recently used one is evicted. Expired sessions close their sockets.
+    // Call before start().
+    void setSessionLimits(std::chrono::seconds idleTtl, std::size_t maxSessions);
 
-private:
-    struct ClientKey {
-        udp::endpoint endpoint;
-        bool operator<(const ClientKey& other) const {
-            if (endpoint.address().to_string() == other.endpoint.address().to_string()) {
-                return endpoint.port() < other.endpoint.port();
-            }
-            return endpoint.address().to_string() < other.endpoint.address().to_string();
-        }
+    // Linux: coalesce bulk same-size datagrams with UDP_GRO and carry each
+    // run as one segmented Steam message. The peer must understand '\x04'
+    // frames (this build always does). Call before start().
+    void setSegmentOffload(bool enabled);
+
+    struct SessionStats {
+        std::uint64_t created = 0;
+        std::uint64_t expired = 0;
+        std::uint64_t evicted = 0;
+        std::size_t active = 0;
     };
+    SessionStats sessionStats();
+
+    // Takes ownership of a '\x02' or '\x04' tunnel message; it is released once the
+    // payload has been written to the local socket.
+    void handleTunnelMessage(HSteamNetConnection conn, ISteamNetworkingMessage* message);
 
+private:
     struct TargetSession;
+    struct Shard;
+
+    // One local datagram bound for the tunnel, borrowed from a receive
+    // buffer; `frame` is the writable header room right before `data`
+    struct TunnelDatagram {
+        UdpSessionId id;
+        const char* data;
+        std::size_t len;
+        char* frame;
+        std::size_t segmentSize = 0; // >0: GRO-coalesced run of this size
+    };
+    // One tunnel datagram bound for a local socket, borrowed from `message`
+    struct OutboundDatagram {
+        UdpSessionId id;
+        HSteamNetConnection conn;
+        ISteamNetworkingMessage* message;
+        const char* data;
+        std::size_t len;
+        std::size_t segmentSize; // >0: re-segment into datagrams of this size
+    };
+
+    struct SessionActivity {
+        std::uint32_t lastTick;
+        std::uint64_t generation; // tells a recreated id from a stale wheel entry
+        std::list<UdpSessionId>::iterator lruPos;
+    };
+    struct WheelEntry {
+        UdpSessionId id;
+        std::uint64_t generation;
+    };
+
+    static constexpr std::size_t kWheelSlots = 64;
+    static constexpr std::chrono::seconds kWheelTick{1};
 
-    void startReceive();
-    void startTargetReceive(const std::string& id, const std::shared_ptr<TargetSession>& session);
-    void notifyClientCount(int count);
-    void sendTunnelPacket(const std::string& id, const char* data, size_t len);
+    std::size_t shardFor(UdpSessionId id) const;
+    UdpSessionId sessionForEndpoint(Shard& shard, const udp::endpoint& endpoint);
+    void touchSessionLocked(Shard& shard, UdpSessionId id);
+    void removeSessionLocked(Shard& shard, UdpSessionId id);
+    void scheduleExpiryTick(Shard& shard);
+    void expireIdleSessions(Shard& shard);
+    void startReceive(Shard& shard);
+    void startTargetReceive(Shard& shard, UdpSessionId id, const std::shared_ptr<TargetSession>& session);
+    void notifyClientCount();
+    void sendTunnelBatch(Shard& shard, TunnelDatagram* datagrams, std::size_t count);
+    void appendSegmentedMessages(Shard& shard, ISteamNetworkingSockets* interfacePtr, ISteamNetworkingUtils* utils,
+                                 HSteamNetConnection targetConn, const TunnelDatagram& datagram);
+    void flushOutbound(Shard& shard);
+    void sendSegmentedLocal(Shard& shard, std::size_t index);
 
     int bindPort_;
     int targetPort_;
-    bool running_;
-    boost::asio::io_context io_context_;
-    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_;
-    udp::socket socket_;
-    udp::endpoint remoteEndpoint_;
-    std::array<char, 65536> recvBuffer_;
-    std::thread worker_;
+    std::size_t threadCount_;
+    std::atomic<bool> running_;
+    std::vector<std::unique_ptr<Shard>> shards_;
     SteamNetworkingManager* manager_;
     std::function<void(int)> clientCountCallback_;
 
-    std::mutex clientsMutex_;
-    std::map<ClientKey, std::string> clientToId_;
-    std::map<std::string, ClientKey> idToClient_;
-    std::map<std::string, HSteamNetConnection> idToConn_;
-    std::map<std::string, std::shared_ptr<TargetSession>> targetSessions_;
+    bool segmentOffload_ = false;
+    std::uint32_t idleTtlTicks_ = 120;
+    std::size_t maxSessionsPerShard_ = 4096;
+    std::atomic<int> clientCount_{0};
+    std::atomic<std::uint64_t> sessionsCreated_{0};
+    std::atomic<std::uint64_t> sessionsExpired_{0};
+    std::atomic<std::uint64_t> sessionsEvicted_{0};
 };
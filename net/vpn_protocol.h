@@ -16,6 +16,20 @@ constexpr int64_t LEASE_TIME_MS = 120000;
 constexpr int64_t LEASE_EXPIRY_MS = 360000;
 constexpr int64_t HEARTBEAT_EXPIRY_MS = 180000;
 
+// Candidates probed per round: the first rides in ProbeRequestPayload, the
+// rest follow it as network-order uint32s that older peers ignore.
+constexpr size_t MAX_PROBE_CANDIDATES = 4;
+
+// Gossip membership. Every round a node heartbeats a few peers (about
+// log2 N) in shuffled round-robin order, so each peer still hears from it
+// directly every N / fanout rounds, and piggybacks what it knows about
+// others. An unacked heartbeat is retried through a few intermediaries
+// before the target is suspected; removal is still left to lease expiry.
+constexpr int64_t GOSSIP_INTERVAL_MS = 15000;
+constexpr int64_t GOSSIP_ACK_TIMEOUT_MS = 3000;
+constexpr size_t GOSSIP_INDIRECT_PROBES = 3;
+constexpr size_t MAX_GOSSIP_ENTRIES = 16;
+
 // Node ID
 constexpr size_t NODE_ID_SIZE = 32;
 using NodeID = std::array<uint8_t, NODE_ID_SIZE>;
@@ -25,13 +39,19 @@ constexpr uint8_t VPN_CAP_PASSWORD = 0x01;
 
 enum class VpnMessageType : uint8_t {
   IP_PACKET = 1,
-  ROUTE_UPDATE = 3,
+  ROUTE_UPDATE = 3, // legacy unversioned table, still accepted
+  ROUTE_DELTA = 4,
+  ROUTE_SNAPSHOT = 5,
+  ROUTE_SNAPSHOT_REQUEST = 6,
   PROBE_REQUEST = 10,
   PROBE_RESPONSE = 11,
   ADDRESS_ANNOUNCE = 12,
   FORCED_RELEASE = 13,
   HEARTBEAT = 14,
   HEARTBEAT_ACK = 15,
+  PROBE_ACK = 16,
+  HEARTBEAT_PING_REQ = 17,
+  KEEPALIVE = 18,
   SESSION_HELLO = 20
 };
 
@@ -57,11 +77,51 @@ struct ProbeResponsePayload {
   int64_t lastHeartbeatMs;
 };
 
+// Versioned routes. Each sender numbers its first-hand route changes with
+// an epoch; `incarnation` is drawn at random per bridge start so a restarted
+// sender never looks like a stale one. A sender's first delta sets the
+// receiver's baseline; after that a gap still applies the delta and asks
+// for a snapshot.
+constexpr uint8_t ROUTE_OP_REMOVE = 0;
+constexpr uint8_t ROUTE_OP_ADD = 1;
+// Keeps every route message well under the uint16_t header length
+constexpr size_t MAX_ROUTE_ENTRIES_PER_MESSAGE = 4096;
+
+struct RouteDeltaHeader {
+  uint32_t incarnation;
+  uint32_t baseEpoch;
+  uint32_t epoch;
+  // followed by RouteOpEntry[]
+};
+
+struct RouteOpEntry {
+  uint8_t op;
+  uint64_t steamId;
+  uint32_t ipAddress; // network byte order
+};
+
+struct RouteSnapshotHeader {
+  uint32_t incarnation;
+  uint32_t epoch;
+  // followed by ROUTE_UPDATE-style (uint64 steamId, uint32 ip) entries
+};
+
+// Sent for every PROBE_REQUEST, after any PROBE_RESPONSE it triggered.
+// ipAddress echoes the request's first candidate.
+struct ProbeAckPayload {
+  uint32_t ipAddress;
+  NodeID nodeId;
+};
+
 struct AddressAnnouncePayload {
   uint32_t ipAddress;
   NodeID nodeId;
 };
 
+// Optional flags byte after AddressAnnouncePayload; older peers stop
+// reading before it. A resumed claim gives way to whoever holds the address.
+constexpr uint8_t ANNOUNCE_FLAG_RESUMED = 0x01;
+
 struct ForcedReleasePayload {
   uint32_t ipAddress;
   NodeID winnerNodeId;
@@ -73,6 +133,33 @@ struct HeartbeatPayload {
   int64_t timestampMs;
 };
 
+// Optional tail of HEARTBEAT and HEARTBEAT_ACK; older peers stop reading
+// after HeartbeatPayload. A HEARTBEAT that carries it expects an ack.
+struct GossipHeader {
+  uint8_t flags; // reserved, 0
+  uint8_t count;
+  // followed by GossipEntry[count]
+};
+
+struct GossipEntry {
+  uint64_t steamId;
+  uint32_t ipAddress; // network byte order
+  uint32_t ageMs;     // time since the sender last heard from the node
+};
+
+// Asks the receiver to heartbeat `targetSteamId` and relay its ack
+struct HeartbeatPingReqPayload {
+  uint64_t targetSteamId;
+};
+
+// Data-channel keepalive, handled next to SESSION_HELLO and never passed to
+// the bridge. Older builds hand it to the bridge, which ignores it.
+constexpr uint8_t KEEPALIVE_FLAG_REPLY = 0x01; // sender wants an answer
+
+struct KeepalivePayload {
+  uint8_t flags;
+};
+
 struct SessionHelloPayload {
   char version[VPN_VERSION_MAX_LEN];
   uint8_t capabilities;
@@ -86,6 +173,9 @@ struct NodeInfo {
   std::chrono::steady_clock::time_point lastHeartbeat;
   std::string name;
   bool isLocal;
+  // Missed a direct and an indirect gossip probe; not vouched for until
+  // heard from again
+  bool suspect = false;
 
   bool isActive() const {
     const auto now = std::chrono::steady_clock::now();
@@ -2,6 +2,7 @@
 
 #include "../net/tcp_server.h"
 #include "../net/udp_forwarder.h"
+#include "../steam/steam_message_handler.h"
 #include "../steam/steam_networking_manager.h"
 #include "../steam/steam_room_manager.h"
 #include "../steam/steam_utils.h"
@@ -540,6 +541,34 @@ int Backend::tcpClients() const {
   return server_ ? server_->getClientCount() : 0;
 }
 
+QVariantMap Backend::udpSessionStats() const {
+  QVariantMap stats;
+  if (!udpForwarder_) {
+    return stats;
+  }
+  const auto snapshot = udpForwarder_->sessionStats();
+  stats.insert(QStringLiteral("created"), static_cast<qulonglong>(snapshot.created));
+  stats.insert(QStringLiteral("expired"), static_cast<qulonglong>(snapshot.expired));
+  stats.insert(QStringLiteral("evicted"), static_cast<qulonglong>(snapshot.evicted));
+  stats.insert(QStringLiteral("active"), static_cast<qulonglong>(snapshot.active));
+  return stats;
+}
+
+QVariantMap Backend::tunnelLatencyStats() const {
+  QVariantMap stats;
+  auto *handler = steamManager_ ? steamManager_->getMessageHandler() : nullptr;
+  if (!handler) {
+    return stats;
+  }
+  const auto snapshot = handler->latency().snapshot();
+  stats.insert(QStringLiteral("count"), static_cast<qulonglong>(snapshot.count));
+  stats.insert(QStringLiteral("p50Us"), static_cast<qlonglong>(snapshot.p50Us));
+  stats.insert(QStringLiteral("p99Us"), static_cast<qlonglong>(snapshot.p99Us));
+  stats.insert(QStringLiteral("maxUs"), static_cast<qlonglong>(snapshot.maxUs));
+  stats.insert(QStringLiteral("jitterUs"), static_cast<qlonglong>(snapshot.jitterUs));
+  return stats;
+}
+
 void Backend::setJoinTarget(const QString &id) {
   if (joinTarget_ == id) {
     return;
@@ -643,6 +672,16 @@ bool Backend::tryInitializeSteam() {
     return false;
   }
 
+  {
+    QSettings settings;
+    // Parallel P2P connections per client; 1 keeps a single connection
+    steamManager_->setTunnelStripes(
+        settings.value(QStringLiteral("net/tunnelStripes"), 1).toInt());
+    // Off by default: peers built before '\x03' frames misread them
+    steamManager_->setTunnelBatching(
+        settings.value(QStringLiteral("net/tunnelBatching"), false).toBool());
+  }
+
   roomManager_ = std::make_unique<SteamRoomManager>(steamManager_.get());
   steamManager_->setRoomManager(roomManager_.get());
   roomManager_->setAdvertisedMode(inTunMode());
@@ -767,6 +806,7 @@ void Backend::startHosting() {
     vpnHosting_ = true;
     bool started = vpnBridge_->isRunning();
     if (!started) {
+      vpnBridge_->setLeaseScope(0);
       started = vpnBridge_->start();
       updateVpnInfo();
     }
@@ -808,7 +848,22 @@ void Backend::ensureServerRunning() {
       return;
     }
     const int bindPort = isHost() ? 0 : localBindPort_;
-    udpForwarder_ = std::make_unique<UDPForwarder>(bindPort, localPort_, steamManager_.get());
+    QSettings settings;
+    // Worker shards for the forwarder; >1 spreads clients over threads
+    const int threads =
+        settings.value(QStringLiteral("net/udpForwarderThreads"), 1).toInt();
+    udpForwarder_ = std::make_unique<UDPForwarder>(
+        bindPort, localPort_, steamManager_.get(),
+        static_cast<std::size_t>(std::clamp(threads, 1, 16)));
+    const int idleTtlSec =
+        settings.value(QStringLiteral("net/udpSessionIdleTtlSec"), 120).toInt();
+    const int maxSessions =
+        settings.value(QStringLiteral("net/udpMaxSessions"), 4096).toInt();
+    udpForwarder_->setSessionLimits(std::chrono::seconds(std::max(idleTtlSec, 1)),
+                                    static_cast<std::size_t>(std::max(maxSessions, 1)));
+    // Off by default: peers built before '\x04' frames drop them
+    udpForwarder_->setSegmentOffload(
+        settings.value(QStringLiteral("net/udpSegmentOffload"), false).toBool());
     steamManager_->setUdpForwarder(udpForwarder_.get());
     udpForwarder_->setClientCountCallback([this](int count) {
       QMetaObject::invokeMethod(
@@ -872,6 +927,14 @@ void Backend::ensureVpnSetup() {
   if (!vpnBridge_) {
     vpnBridge_ = std::make_unique<SteamVpnBridge>(vpnManager_.get());
     vpnManager_->setVpnBridge(vpnBridge_.get());
+    const QString appDataDir =
+        QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (!appDataDir.isEmpty() && QDir().mkpath(appDataDir)) {
+      vpnBridge_->setLeaseCachePath(
+          QDir(appDataDir)
+              .filePath(QStringLiteral("vpn_leases.txt"))
+              .toStdString());
+    }
   }
   if (roomManager_) {
     roomManager_->setVpnMode(inTunMode(), vpnManager_.get());
@@ -1016,6 +1079,7 @@ void Backend::joinHost() {
       setJoinTargetFromLobby(trimmedTarget);
       if (roomManager_ && roomManager_->joinLobby(targetSteamID)) {
         if (!vpnBridge_->isRunning()) {
+          vpnBridge_->setLeaseScope(targetSteamID.ConvertToUint64());
           if (!vpnBridge_->start()) {
             qWarning() << tr("无法启动 TUN 设备，请检查权限或驱动。");
             return;
@@ -1032,6 +1096,7 @@ void Backend::joinHost() {
       }
     } else if (targetIsUser) {
       if (!vpnBridge_->isRunning()) {
+        vpnBridge_->setLeaseScope(0);
         if (!vpnBridge_->start()) {
           qWarning() << tr("无法启动 TUN 设备，请检查权限或驱动。");
           return;
@@ -1112,6 +1177,7 @@ void Backend::joinLobby(const QString &lobbyId) {
     setJoinTargetFromLobby(trimmedId);
     if (roomManager_ && roomManager_->joinLobby(lobby)) {
       if (!vpnBridge_->isRunning()) {
+        vpnBridge_->setLeaseScope(lobby.ConvertToUint64());
         if (!vpnBridge_->start()) {
           qWarning() << tr("无法启动 TUN 设备，请检查权限或驱动。");
           return;
@@ -1569,6 +1635,7 @@ void Backend::handleLobbyModeChanged(bool wantsTun, const CSteamID &lobby) {
   vpnStartAttempted_ = false;
   // Start TUN bridge immediately so the device appears for guests.
   if (vpnBridge_ && !vpnBridge_->isRunning()) {
+    vpnBridge_->setLeaseScope(lobby.ConvertToUint64());
     if (!vpnBridge_->start()) {
       qWarning() << tr("无法启动 TUN 设备，请检查权限或驱动。");
       return;
@@ -1597,6 +1664,8 @@ void Backend::ensureVpnRunning() {
     return;
   }
   vpnStartAttempted_ = true;
+  vpnBridge_->setLeaseScope(
+      roomManager_ ? roomManager_->getCurrentLobby().ConvertToUint64() : 0);
   if (!vpnBridge_->start()) {
     qWarning() << tr("无法启动 TUN 设备，请检查权限或驱动。");
     vpnConnected_ = false;
@@ -2420,7 +2489,12 @@ void Backend::tick() {
 
   if (inTunMode()) {
     ensureVpnRunning();
-    syncVpnPeers();
+    // Lobby member deltas add and remove peers as they happen; the full
+    // roster is only reconciled now and then in case a callback was missed
+    if (now - lastVpnPeerSync_ > std::chrono::seconds(5)) {
+      syncVpnPeers();
+      lastVpnPeerSync_ = now;
+    }
     updateVpnInfo();
   }
 
@@ -225,6 +225,9 @@ public:
   Q_INVOKABLE void runNetworkSelfCheck();
   Q_INVOKABLE void runNetworkQuickFix();
   Q_INVOKABLE void runNetworkFixFor(const QString &key);
+  // UDP forwarder session counters (created/expired/evicted/active).
+  Q_INVOKABLE QVariantMap udpSessionStats() const;
+  Q_INVOKABLE QVariantMap tunnelLatencyStats() const;
   Q_INVOKABLE void setRoomPassword(const QString &password);
   Q_INVOKABLE bool isChristmasToday() const;
   Q_INVOKABLE bool shouldShowChristmasDialog() const;
@@ -369,6 +372,7 @@ private:
   bool lobbyRefreshing_ = false;
   std::chrono::steady_clock::time_point lastPingBroadcast_;
   std::chrono::steady_clock::time_point lastRelayPingSample_;
+  std::chrono::steady_clock::time_point lastVpnPeerSync_;
   ConnectionMode defaultConnectionMode_ = ConnectionMode::Tun;
   ConnectionMode connectionMode_ = ConnectionMode::Tun;
   bool vpnHosting_ = false;
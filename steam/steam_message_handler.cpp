@@ -1,112 +1,271 @@
 #include "steam_message_handler.h"
 #include "steam_networking_manager.h"
 #include "../net/udp_forwarder.h"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <iostream>
 #include <isteamnetworkingsockets.h>
 #include <steam_api.h>
 
-SteamMessageHandler::SteamMessageHandler(
-    boost::asio::io_context &io_context, ISteamNetworkingSockets *interface,
-    std::vector<HSteamNetConnection> &connections, std::mutex &connectionsMutex,
-    bool &g_isHost, int &localPort, SteamNetworkingManager *owner)
-    : io_context_(io_context), m_pInterface_(interface),
-      connections_(connections), connectionsMutex_(connectionsMutex),
-      g_isHost_(g_isHost), localPort_(localPort), multiplexManagers_(),
-      timer_(), running_(false), currentPollInterval_(0), owner_(owner) {}
+namespace {
+constexpr int kMaxMessagesPerPoll = 256;
+// Messages waiting for the io_context thread; the Steam thread parks the rest
+constexpr std::size_t kInboxCapacity = 4096;
+// Parked beyond the ring before the thread stops pulling from Steam, which
+// keeps the reliable channel's flow control reaching a stalled consumer
+constexpr std::size_t kMaxOverflow = 4096;
+// Idle polls spent yielding before the thread starts sleeping
+constexpr int kSpinRounds = 200;
+constexpr auto kIdleSleep = std::chrono::microseconds(500);
 
-SteamMessageHandler::~SteamMessageHandler() { stop(); }
+bool isUdpTunnelMessage(const ISteamNetworkingMessage *msg) {
+  const char *data = static_cast<const char *>(msg->m_pData);
+  return msg->m_cbSize >= 1 && (data[0] == '\x02' || data[0] == '\x04');
+}
+} // namespace
+
+SteamMessageHandler::SteamMessageHandler(boost::asio::io_context &io_context,
+                                         ISteamNetworkingSockets *interface,
+                                         bool &g_isHost, int &localPort,
+                                         SteamNetworkingManager *owner)
+    : io_context_(io_context), m_pInterface_(interface), g_isHost_(g_isHost),
+      localPort_(localPort), pollGroup_(k_HSteamNetPollGroup_Invalid),
+      running_(false), inbox_(kInboxCapacity), drainPosted_(false),
+      owner_(owner) {}
+
+SteamMessageHandler::~SteamMessageHandler() {
+  stop();
+  ISteamNetworkingMessage *msg = nullptr;
+  while (inbox_.pop(msg)) {
+    msg->Release();
+  }
+  for (ISteamNetworkingMessage *parked : overflow_) {
+    parked->Release();
+  }
+  overflow_.clear();
+  if (pollGroup_ != k_HSteamNetPollGroup_Invalid) {
+    m_pInterface_->DestroyPollGroup(pollGroup_);
+  }
+}
 
 void SteamMessageHandler::start() {
   if (running_)
     return;
   running_ = true;
-  timer_ = std::make_unique<boost::asio::steady_timer>(io_context_);
-  startAsyncPoll();
+  if (pollGroup_ == k_HSteamNetPollGroup_Invalid) {
+    pollGroup_ = m_pInterface_->CreatePollGroup();
+    // Connections registered before start() join now
+    for (const auto &slot : slots_) {
+      if (slot.conn != k_HSteamNetConnection_Invalid) {
+        m_pInterface_->SetConnectionPollGroup(slot.conn, pollGroup_);
+      }
+    }
+  }
+  steamThread_ = std::thread([this]() { runSteamThread(); });
 }
 
 void SteamMessageHandler::stop() {
   if (!running_)
     return;
   running_ = false;
-  if (timer_) {
-    timer_->cancel();
+  if (steamThread_.joinable()) {
+    steamThread_.join();
   }
 }
 
 std::shared_ptr<MultiplexManager>
 SteamMessageHandler::getMultiplexManager(HSteamNetConnection conn) {
-  if (multiplexManagers_.find(conn) == multiplexManagers_.end()) {
-    multiplexManagers_[conn] = std::make_shared<MultiplexManager>(
-        m_pInterface_, conn, io_context_, g_isHost_, localPort_);
+  if (conn == k_HSteamNetConnection_Invalid) {
+    return nullptr;
   }
-  return multiplexManagers_[conn];
+  ConnectionSlot *slot =
+      findSlot(conn, m_pInterface_->GetConnectionUserData(conn));
+  return slot ? slot->manager : nullptr;
 }
 
-void SteamMessageHandler::startAsyncPoll() {
-  if (!running_)
-    return;
-
-  // Poll networking callbacks
-  m_pInterface_->RunCallbacks();
-
-  // Receive messages and check if any were received
-  int totalMessages = 0;
-  std::vector<HSteamNetConnection> currentConnections;
-  {
-    std::lock_guard<std::mutex> lockConn(connectionsMutex_);
-    currentConnections = connections_;
-  }
-  for (auto conn : currentConnections) {
-    ISteamNetworkingMessage *pIncomingMsgs[256];
-    int numMsgs =
-        m_pInterface_->ReceiveMessagesOnConnection(conn, pIncomingMsgs, 256);
-    totalMessages += numMsgs;
-    for (int i = 0; i < numMsgs; ++i) {
-      ISteamNetworkingMessage *pIncomingMsg = pIncomingMsgs[i];
-      const char *data = (const char *)pIncomingMsg->m_pData;
-      size_t size = pIncomingMsg->m_cbSize;
-      if (size >= 1 && data[0] == '\x02') {
-        handleUdpTunnelPacket(conn, data + 1, size - 1);
-      } else {
-        if (multiplexManagers_.find(conn) == multiplexManagers_.end()) {
-          multiplexManagers_[conn] = std::make_shared<MultiplexManager>(
-              m_pInterface_, conn, io_context_, g_isHost_, localPort_);
-        }
-        multiplexManagers_[conn]->handleTunnelPacket(data, size);
+void SteamMessageHandler::leastLoadedManager(
+    std::vector<HSteamNetConnection> stripes,
+    std::function<void(std::shared_ptr<MultiplexManager>)> done) {
+  boost::asio::post(io_context_, [this, stripes = std::move(stripes),
+                                  done = std::move(done)]() {
+    std::shared_ptr<MultiplexManager> best;
+    std::size_t bestStreams = 0;
+    for (auto conn : stripes) {
+      auto manager = getMultiplexManager(conn);
+      if (!manager) {
+        continue;
+      }
+      const std::size_t streams = manager->activeStreams();
+      if (!best || streams < bestStreams) {
+        best = std::move(manager);
+        bestStreams = streams;
       }
-      pIncomingMsg->Release();
     }
+    done(std::move(best));
+  });
+}
+
+void SteamMessageHandler::addConnection(HSteamNetConnection conn) {
+  if (conn == k_HSteamNetConnection_Invalid) {
+    return;
+  }
+  boost::asio::post(io_context_, [this, conn]() {
+    slotFor(conn, m_pInterface_->GetConnectionUserData(conn));
+  });
+}
+
+void SteamMessageHandler::removeConnection(HSteamNetConnection conn) {
+  boost::asio::post(io_context_, [this, conn]() { releaseSlot(conn); });
+}
+
+SteamMessageHandler::ConnectionSlot *
+SteamMessageHandler::findSlot(HSteamNetConnection conn, int64 userData) {
+  if (userData >= 0 && static_cast<std::size_t>(userData) < slots_.size() &&
+      slots_[static_cast<std::size_t>(userData)].conn == conn) {
+    return &slots_[static_cast<std::size_t>(userData)];
   }
+  return nullptr;
+}
 
-  // Adaptive polling: if messages received, poll immediately; otherwise
-  // increase interval (keep small to avoid backlog)
-  if (totalMessages > 0) {
-    currentPollInterval_ = 0; // 有消息，立即轮询
+SteamMessageHandler::ConnectionSlot &
+SteamMessageHandler::slotFor(HSteamNetConnection conn, int64 userData) {
+  if (ConnectionSlot *slot = findSlot(conn, userData)) {
+    return *slot;
+  }
+
+  std::size_t index;
+  if (!freeSlots_.empty()) {
+    index = freeSlots_.back();
+    freeSlots_.pop_back();
   } else {
-    // 无消息，逐渐增加间隔，最大2ms，优先低延迟
-    currentPollInterval_ = std::min(currentPollInterval_ + 1, 2);
+    index = slots_.size();
+    slots_.emplace_back();
+  }
+  ConnectionSlot &slot = slots_[index];
+  slot.conn = conn;
+  slot.manager = std::make_shared<MultiplexManager>(
+      m_pInterface_, conn, io_context_, g_isHost_, localPort_);
+  slot.manager->setBatching(owner_ && owner_->tunnelBatching());
+  m_pInterface_->SetConnectionUserData(conn, static_cast<int64>(index));
+  if (pollGroup_ != k_HSteamNetPollGroup_Invalid) {
+    m_pInterface_->SetConnectionPollGroup(conn, pollGroup_);
   }
+  return slot;
+}
 
-  // Schedule next poll
-  timer_->expires_after(std::chrono::milliseconds(currentPollInterval_));
-  timer_->async_wait([this](const boost::system::error_code &error) {
-    if (!error && running_) {
-      startAsyncPoll();
+void SteamMessageHandler::releaseSlot(HSteamNetConnection conn) {
+  std::size_t index = slots_.size();
+  if (ConnectionSlot *slot =
+          findSlot(conn, m_pInterface_->GetConnectionUserData(conn))) {
+    index = static_cast<std::size_t>(slot - slots_.data());
+  } else {
+    // The handle is already gone from Steam; fall back to a scan
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i].conn == conn) {
+        index = i;
+        break;
+      }
     }
-  });
+  }
+  if (index == slots_.size()) {
+    return;
+  }
+  // Pending socket handlers hold their own references; the manager goes
+  // away once the last of them has observed the shutdown.
+  slots_[index].manager->shutdown();
+  slots_[index].manager.reset();
+  slots_[index].conn = k_HSteamNetConnection_Invalid;
+  freeSlots_.push_back(index);
 }
 
-void SteamMessageHandler::handleUdpTunnelPacket(HSteamNetConnection conn,
-                                                const char* data,
-                                                size_t len) {
-  if (!owner_) {
-    return;
+void SteamMessageHandler::runSteamThread() {
+  ISteamNetworkingMessage *pIncomingMsgs[kMaxMessagesPerPoll];
+  int idleRounds = 0;
+  while (running_) {
+    // Poll networking callbacks
+    m_pInterface_->RunCallbacks();
+
+    // Move messages parked while the ring was full into the room the last
+    // drain freed
+    bool queued = false;
+    while (!overflow_.empty() && inbox_.push(overflow_.front())) {
+      overflow_.pop_front();
+      queued = true;
+    }
+
+    // Keep receiving when the ring is full so UDP is not held up behind a
+    // short TCP backlog; TCP messages that do not fit are parked until the
+    // next drain. Never take more than the overflow can still park.
+    const int room = static_cast<int>(std::min<std::size_t>(
+        kMaxOverflow - overflow_.size(), kMaxMessagesPerPoll));
+    const int numMsgs =
+        room > 0 ? m_pInterface_->ReceiveMessagesOnPollGroup(
+                       pollGroup_, pIncomingMsgs, room)
+                 : 0;
+    if (numMsgs > 0) {
+      const SteamNetworkingMicroseconds now =
+          SteamNetworkingUtils()->GetLocalTimestamp();
+      for (int i = 0; i < numMsgs; ++i) {
+        ISteamNetworkingMessage *pIncomingMsg = pIncomingMsgs[i];
+        if (isUdpTunnelMessage(pIncomingMsg)) {
+          latency_.record(now - pIncomingMsg->m_usecTimeReceived);
+          handleUdpTunnelMessage(pIncomingMsg->m_conn, pIncomingMsg);
+        } else if (overflow_.empty() && inbox_.push(pIncomingMsg)) {
+          queued = true;
+        } else {
+          overflow_.push_back(pIncomingMsg);
+        }
+      }
+    }
+    if (queued && !drainPosted_.exchange(true)) {
+      boost::asio::post(io_context_, [this]() { drainInbox(); });
+    }
+    if (numMsgs > 0 || queued) {
+      idleRounds = 0;
+      continue;
+    }
+
+    // Spin briefly so a burst's next message is picked up at once, then
+    // sleep so an idle tunnel does not burn a core
+    if (++idleRounds < kSpinRounds) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(kIdleSleep);
+    }
   }
-  auto *forwarder = owner_->getUdpForwarder();
+}
+
+void SteamMessageHandler::drainInbox() {
+  // Cleared first so a message pushed after the last pop posts a new drain
+  drainPosted_.store(false);
+  const SteamNetworkingMicroseconds now =
+      SteamNetworkingUtils()->GetLocalTimestamp();
+  ISteamNetworkingMessage *pIncomingMsg = nullptr;
+  while (inbox_.pop(pIncomingMsg)) {
+    latency_.record(now - pIncomingMsg->m_usecTimeReceived);
+    ConnectionSlot *slot =
+        findSlot(pIncomingMsg->m_conn, pIncomingMsg->m_nConnUserData);
+    if (!slot) {
+      // Connection already closed and its tunnel state torn down
+      pIncomingMsg->Release();
+      continue;
+    }
+    MultiplexManager *manager = slot->manager.get();
+    // The local socket write borrows the payload; release on completion.
+    std::shared_ptr<ISteamNetworkingMessage> owner(
+        pIncomingMsg, [](ISteamNetworkingMessage *msg) { msg->Release(); });
+    manager->handleTunnelPacket(static_cast<const char *>(owner->m_pData),
+                                static_cast<size_t>(owner->m_cbSize), owner);
+  }
+}
+
+void SteamMessageHandler::handleUdpTunnelMessage(
+    HSteamNetConnection conn, ISteamNetworkingMessage *message) {
+  auto *forwarder = owner_ ? owner_->getUdpForwarder() : nullptr;
   if (!forwarder) {
+    message->Release();
     return;
   }
-  forwarder->handleTunnelPacket(conn, data, len);
+  forwarder->handleTunnelMessage(conn, message);
 }
@@ -1,50 +1,90 @@
 #ifndef STEAM_MESSAGE_HANDLER_H
 #define STEAM_MESSAGE_HANDLER_H
 
+#include "../net/latency_histogram.h"
 #include "../net/multiplex_manager.h"
+#include "../net/spsc_queue.h"
+#include <atomic>
 #include <boost/asio.hpp>
-#include <map>
+#include <cstddef>
+#include <deque>
+#include <functional>
 #include <memory>
-#include <mutex>
 #include <steamnetworkingtypes.h>
 #include <thread>
 #include <vector>
 
 class SteamNetworkingManager;
 
+// Drains every tunnel connection through one Steam poll group on a dedicated
+// thread, which also runs Steam's connection status callbacks. UDP tunnel
+// messages are handed to the forwarder right there; TCP tunnel messages cross
+// to the io_context thread through a lock-free ring, and the connection table
+// below is only touched on that thread.
 class SteamMessageHandler {
 public:
   SteamMessageHandler(boost::asio::io_context &io_context,
-                      ISteamNetworkingSockets *interface,
-                      std::vector<HSteamNetConnection> &connections,
-                      std::mutex &connectionsMutex, bool &g_isHost,
+                      ISteamNetworkingSockets *interface, bool &g_isHost,
                       int &localPort, SteamNetworkingManager *owner);
   ~SteamMessageHandler();
 
   void start();
   void stop();
 
+  // io_context thread only; null until addConnection() has run for `conn`.
   std::shared_ptr<MultiplexManager>
   getMultiplexManager(HSteamNetConnection conn);
+  // Looks up, on the io_context thread, the manager of the stripe carrying
+  // the fewest streams and passes it to `done` there (null when none has
+  // one). A new stream stays pinned to it for its whole life.
+  void leastLoadedManager(
+      std::vector<HSteamNetConnection> stripes,
+      std::function<void(std::shared_ptr<MultiplexManager>)> done);
 
-  void handleUdpTunnelPacket(HSteamNetConnection conn, const char* data, size_t len);
+  // Joins `conn` to the poll group and gives it a handler slot; idempotent.
+  // Both are safe from any thread.
+  void addConnection(HSteamNetConnection conn);
+  // Shuts down the closed connection's MultiplexManager and frees its slot.
+  void removeConnection(HSteamNetConnection conn);
+
+  // Steam receive -> dispatch latency of tunnel messages
+  const LatencyHistogram &latency() const { return latency_; }
+
+  // Hands a '\x02'/'\x04' message to the UDP forwarder, which releases it
+  // when done.
+  void handleUdpTunnelMessage(HSteamNetConnection conn, ISteamNetworkingMessage* message);
 
 private:
-  void startAsyncPoll();
+  // Flat connection -> handler table; a connection's slot index is stored as
+  // its Steam connection user data and comes back on every message.
+  struct ConnectionSlot {
+    HSteamNetConnection conn = k_HSteamNetConnection_Invalid;
+    std::shared_ptr<MultiplexManager> manager;
+  };
+
+  void runSteamThread();
+  void drainInbox();
+  ConnectionSlot *findSlot(HSteamNetConnection conn, int64 userData);
+  ConnectionSlot &slotFor(HSteamNetConnection conn, int64 userData);
+  void releaseSlot(HSteamNetConnection conn);
 
   boost::asio::io_context &io_context_;
   ISteamNetworkingSockets *m_pInterface_;
-  std::vector<HSteamNetConnection> &connections_;
-  std::mutex &connectionsMutex_;
   bool &g_isHost_;
   int &localPort_;
 
-  std::map<HSteamNetConnection, std::shared_ptr<MultiplexManager>>
-      multiplexManagers_;
+  HSteamNetPollGroup pollGroup_;
+  std::vector<ConnectionSlot> slots_;
+  std::vector<std::size_t> freeSlots_;
 
-  std::unique_ptr<boost::asio::steady_timer> timer_;
-  bool running_;
-  int currentPollInterval_; // 当前轮询间隔（毫秒）
+  std::thread steamThread_;
+  std::atomic<bool> running_;
+  SpscQueue<ISteamNetworkingMessage *> inbox_;
+  // Steam thread only: TCP messages that did not fit in the ring, in order.
+  // Bounded by kMaxOverflow; once full the poll group is left alone.
+  std::deque<ISteamNetworkingMessage *> overflow_;
+  std::atomic<bool> drainPosted_;
+  LatencyHistogram latency_;
   SteamNetworkingManager *owner_;
 };
 
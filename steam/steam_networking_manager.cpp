@@ -127,6 +127,11 @@ void SteamNetworkingManager::shutdown() {
   if (g_hConnection != k_HSteamNetConnection_Invalid) {
     m_pInterface->CloseConnection(g_hConnection, 0, nullptr, false);
   }
+  for (auto conn : clientStripes_) {
+    m_pInterface->CloseConnection(conn, 0, nullptr, false);
+  }
+  clientStripes_.clear();
+  closeStripeListenSockets();
   if (hListenSock != k_HSteamListenSocket_Invalid) {
     m_pInterface->CloseListenSocket(hListenSock);
   }
@@ -139,6 +144,8 @@ bool SteamNetworkingManager::connectToHostInternal(
     // Avoid stacking multiple connections to the same peer; close stale one
     // before issuing another ConnectP2P to prevent duplicate asserts.
     std::lock_guard<std::mutex> lock(connectionsMutex);
+    closeStripesLocked();
+    stripesRelayOnly_ = relayOnly;
     if (g_hConnection != k_HSteamNetConnection_Invalid) {
       SteamNetConnectionInfo_t info;
       if (m_pInterface->GetConnectionInfo(g_hConnection, &info)) {
@@ -146,8 +153,7 @@ bool SteamNetworkingManager::connectToHostInternal(
                   << info.m_identityRemote.GetSteamID().ConvertToUint64()
                   << " before reconnecting" << std::endl;
       }
-      m_pInterface->CloseConnection(g_hConnection, 0,
-                                    "Replace duplicate connection", false);
+      closeTunnelConnection(g_hConnection, "Replace duplicate connection");
       g_hConnection = k_HSteamNetConnection_Invalid;
       g_isConnected = false;
       hostPing_ = 0;
@@ -210,23 +216,25 @@ void SteamNetworkingManager::disconnect() {
   std::lock_guard<std::mutex> lock(connectionsMutex);
 
   // Close client connection
+  closeStripesLocked();
   if (g_hConnection != k_HSteamNetConnection_Invalid) {
-    m_pInterface->CloseConnection(g_hConnection, 0, nullptr, false);
+    closeTunnelConnection(g_hConnection, nullptr);
     g_hConnection = k_HSteamNetConnection_Invalid;
   }
   connectAttemptStart_ = {};
 
   // Close all host connections
   for (auto conn : connections) {
-    m_pInterface->CloseConnection(conn, 0, nullptr, false);
+    closeTunnelConnection(conn, nullptr);
   }
   connections.clear();
 
-  // Close listen socket
+  // Close listen sockets
   if (hListenSock != k_HSteamListenSocket_Invalid) {
     m_pInterface->CloseListenSocket(hListenSock);
     hListenSock = k_HSteamListenSocket_Invalid;
   }
+  closeStripeListenSockets();
 
   // Reset state
   g_isHost = false;
@@ -255,7 +263,8 @@ void SteamNetworkingManager::closeConnectionToPeer(const CSteamID &peer) {
         info.m_identityRemote.GetSteamID() == peer) {
       std::cout << "[SteamNet] Closing connection to peer "
                 << peer.ConvertToUint64() << std::endl;
-      m_pInterface->CloseConnection(g_hConnection, 0, nullptr, false);
+      closeStripesLocked();
+      closeTunnelConnection(g_hConnection, nullptr);
       g_hConnection = k_HSteamNetConnection_Invalid;
       g_isConnected = false;
       hostPing_ = 0;
@@ -269,7 +278,7 @@ void SteamNetworkingManager::closeConnectionToPeer(const CSteamID &peer) {
         info.m_identityRemote.GetSteamID() == peer) {
       std::cout << "[SteamNet] Closing host connection to peer "
                 << peer.ConvertToUint64() << std::endl;
-      m_pInterface->CloseConnection(*it, 0, nullptr, false);
+      closeTunnelConnection(*it, nullptr);
       it = connections.erase(it);
       continue;
     }
@@ -277,6 +286,105 @@ void SteamNetworkingManager::closeConnectionToPeer(const CSteamID &peer) {
   }
 }
 
+void SteamNetworkingManager::closeTunnelConnection(HSteamNetConnection conn,
+                                                   const char *reason) {
+  m_pInterface->CloseConnection(conn, 0, reason, false);
+  // Steam raises no status callback for a locally closed connection
+  if (messageHandler_) {
+    messageHandler_->removeConnection(conn);
+  }
+}
+
+void SteamNetworkingManager::setTunnelStripes(int stripes) {
+  tunnelStripes_ = std::clamp(stripes, 1, kMaxTunnelStripes);
+}
+
+bool SteamNetworkingManager::openStripeListenSockets() {
+  closeStripeListenSockets();
+  for (int port = 1; port < kMaxTunnelStripes; ++port) {
+    HSteamListenSocket sock =
+        m_pInterface->CreateListenSocketP2P(port, 0, nullptr);
+    if (sock == k_HSteamListenSocket_Invalid) {
+      std::cerr << "[SteamNet] Failed to listen for tunnel stripes on "
+                   "virtual port "
+                << port << std::endl;
+      return false;
+    }
+    stripeListenSocks_.push_back(sock);
+  }
+  return true;
+}
+
+void SteamNetworkingManager::closeStripeListenSockets() {
+  for (auto sock : stripeListenSocks_) {
+    m_pInterface->CloseListenSocket(sock);
+  }
+  stripeListenSocks_.clear();
+}
+
+std::vector<HSteamNetConnection> SteamNetworkingManager::getTunnelStripes() {
+  std::lock_guard<std::mutex> lock(connectionsMutex);
+  std::vector<HSteamNetConnection> stripes;
+  if (!g_isConnected || g_hConnection == k_HSteamNetConnection_Invalid) {
+    return stripes;
+  }
+  stripes.push_back(g_hConnection);
+  if (g_isClient) {
+    stripes.insert(stripes.end(), connectedStripes_.begin(),
+                   connectedStripes_.end());
+  }
+  return stripes;
+}
+
+void SteamNetworkingManager::connectStripesLocked() {
+  if (!g_isClient || tunnelStripes_ <= 1 || !clientStripes_.empty() ||
+      !g_hostSteamID.IsValid()) {
+    return;
+  }
+  SteamNetworkingIdentity identity;
+  identity.SetSteamID(g_hostSteamID);
+
+  // Stripes follow the transport the primary settled on
+  SteamNetworkingConfigValue_t options[2];
+  int optionCount = 0;
+  if (stripesRelayOnly_) {
+    options[optionCount++].SetInt32(
+        k_ESteamNetworkingConfig_P2P_Transport_ICE_Enable, 0);
+    options[optionCount++].SetInt32(
+        k_ESteamNetworkingConfig_P2P_Transport_SDR_Penalty, 0);
+  }
+  for (int port = 1; port < tunnelStripes_; ++port) {
+    HSteamNetConnection conn = m_pInterface->ConnectP2P(
+        identity, port, optionCount, optionCount > 0 ? options : nullptr);
+    if (conn != k_HSteamNetConnection_Invalid) {
+      clientStripes_.push_back(conn);
+    }
+  }
+  std::cout << "[SteamNet] Opening " << clientStripes_.size()
+            << " extra tunnel stripes to host" << std::endl;
+}
+
+void SteamNetworkingManager::closeStripesLocked() {
+  for (auto conn : clientStripes_) {
+    closeTunnelConnection(conn, "Tunnel stripes reset");
+  }
+  clientStripes_.clear();
+  connectedStripes_.clear();
+}
+
+bool SteamNetworkingManager::isClientStripeLocked(
+    HSteamNetConnection conn) const {
+  return std::find(clientStripes_.begin(), clientStripes_.end(), conn) !=
+         clientStripes_.end();
+}
+
+bool SteamNetworkingManager::isHostStripe(
+    HSteamListenSocket listenSocket) const {
+  return listenSocket != k_HSteamListenSocket_Invalid &&
+         std::find(stripeListenSocks_.begin(), stripeListenSocks_.end(),
+                   listenSocket) != stripeListenSocks_.end();
+}
+
 void SteamNetworkingManager::setMessageHandlerDependencies(
     boost::asio::io_context &io_context, std::unique_ptr<TCPServer> &server,
     int &localPort, int &localBindPort) {
@@ -285,8 +393,8 @@ void SteamNetworkingManager::setMessageHandlerDependencies(
   localPort_ = &localPort;
   localBindPort_ = &localBindPort;
   messageHandler_ =
-      new SteamMessageHandler(io_context, m_pInterface, connections,
-                              connectionsMutex, g_isHost, localPort, this);
+      new SteamMessageHandler(io_context, m_pInterface, g_isHost, localPort,
+                              this);
 }
 
 void SteamNetworkingManager::startMessageHandler() {
@@ -396,9 +504,8 @@ void SteamNetworkingManager::update() {
         g_hostSteamID.IsValid()) {
       // Tear down the stuck ICE attempt so we can try relay-only immediately.
       if (g_hConnection != k_HSteamNetConnection_Invalid) {
-        m_pInterface->CloseConnection(g_hConnection, 0,
-                                      "Retry via relay after ICE timeout",
-                                      false);
+        closeTunnelConnection(g_hConnection,
+                              "Retry via relay after ICE timeout");
         g_hConnection = k_HSteamNetConnection_Invalid;
         g_isConnected = false;
       }
@@ -410,8 +517,8 @@ void SteamNetworkingManager::update() {
   }
 
   if (connectionToClose != k_HSteamNetConnection_Invalid) {
-    m_pInterface->CloseConnection(
-        connectionToClose, 0, "Retry via relay after ICE stall", false);
+    closeTunnelConnection(connectionToClose,
+                          "Retry via relay after ICE stall");
   }
 
   if (shouldRetryRelay) {
@@ -513,6 +620,33 @@ void SteamNetworkingManager::handleConnectionStatusChanged(
     std::lock_guard<std::mutex> lock(connectionsMutex);
     std::cout << "Connection status changed: " << pInfo->m_info.m_eState
               << " for connection " << pInfo->m_hConn << std::endl;
+    if (isClientStripeLocked(pInfo->m_hConn)) {
+      // Extra stripes never drive the primary's state or relay fallback
+      const auto state = pInfo->m_info.m_eState;
+      if (state == k_ESteamNetworkingConnectionState_Connected) {
+        connectedStripes_.push_back(pInfo->m_hConn);
+        if (messageHandler_) {
+          messageHandler_->addConnection(pInfo->m_hConn);
+        }
+        std::cout << "[SteamNet] Tunnel stripe connected" << std::endl;
+      } else if (state == k_ESteamNetworkingConnectionState_ClosedByPeer ||
+                 state ==
+                     k_ESteamNetworkingConnectionState_ProblemDetectedLocally) {
+        clientStripes_.erase(std::remove(clientStripes_.begin(),
+                                         clientStripes_.end(), pInfo->m_hConn),
+                             clientStripes_.end());
+        connectedStripes_.erase(std::remove(connectedStripes_.begin(),
+                                            connectedStripes_.end(),
+                                            pInfo->m_hConn),
+                                connectedStripes_.end());
+        closeTunnelConnection(pInfo->m_hConn, nullptr);
+        std::cout << "[SteamNet] Tunnel stripe closed: "
+                  << pInfo->m_info.m_szEndDebug << std::endl;
+      }
+      return;
+    }
+    // Host side: stripes on virtual ports 1.. never stand in for the primary
+    const bool hostStripe = isHostStripe(pInfo->m_info.m_hListenSocket);
     if (pInfo->m_info.m_eState ==
         k_ESteamNetworkingConnectionState_ProblemDetectedLocally) {
       std::cout << "Connection failed: " << pInfo->m_info.m_szEndDebug
@@ -552,29 +686,30 @@ void SteamNetworkingManager::handleConnectionStatusChanged(
             ++it;
             continue;
           }
+          // Stripes from the same peer arrive on other listen sockets
           SteamNetConnectionInfo_t info;
           if (m_pInterface->GetConnectionInfo(*it, &info) &&
-              info.m_identityRemote.GetSteamID() == peer) {
+              info.m_identityRemote.GetSteamID() == peer &&
+              info.m_hListenSocket == pInfo->m_info.m_hListenSocket) {
             std::cout << "[SteamNet] Closing duplicate host connection to "
                       << peer.ConvertToUint64() << std::endl;
-            m_pInterface->CloseConnection(*it, 0,
-                                          "Replace duplicate connection",
-                                          false);
+            closeTunnelConnection(*it, "Replace duplicate connection");
             it = connections.erase(it);
             continue;
           }
           ++it;
         }
 
-        if (g_hConnection != k_HSteamNetConnection_Invalid &&
+        if (!hostStripe && g_hConnection != k_HSteamNetConnection_Invalid &&
             g_hConnection != pInfo->m_hConn) {
           SteamNetConnectionInfo_t info;
           if (m_pInterface->GetConnectionInfo(g_hConnection, &info) &&
+              info.m_hListenSocket == k_HSteamListenSocket_Invalid &&
               info.m_identityRemote.GetSteamID() == peer) {
             std::cout << "[SteamNet] Closing duplicate client connection to "
                       << peer.ConvertToUint64() << std::endl;
-            m_pInterface->CloseConnection(
-                g_hConnection, 0, "Replace duplicate connection", false);
+            closeTunnelConnection(g_hConnection,
+                                  "Replace duplicate connection");
             g_hConnection = k_HSteamNetConnection_Invalid;
             g_isConnected = false;
             hostPing_ = 0;
@@ -584,8 +719,13 @@ void SteamNetworkingManager::handleConnectionStatusChanged(
 
       m_pInterface->AcceptConnection(pInfo->m_hConn);
       connections.push_back(pInfo->m_hConn);
-      g_hConnection = pInfo->m_hConn;
-      g_isConnected = true;
+      if (messageHandler_) {
+        messageHandler_->addConnection(pInfo->m_hConn);
+      }
+      if (!hostStripe) {
+        g_hConnection = pInfo->m_hConn;
+        g_isConnected = true;
+      }
       std::cout << "Accepted incoming connection from "
                 << pInfo->m_info.m_identityRemote.GetSteamID().ConvertToUint64()
                 << std::endl;
@@ -603,7 +743,15 @@ void SteamNetworkingManager::handleConnectionStatusChanged(
                    k_ESteamNetworkingConnectionState_Connecting &&
                pInfo->m_info.m_eState ==
                    k_ESteamNetworkingConnectionState_Connected) {
-      g_isConnected = true;
+      if (!hostStripe) {
+        g_isConnected = true;
+      }
+      if (messageHandler_) {
+        messageHandler_->addConnection(pInfo->m_hConn);
+      }
+      if (pInfo->m_hConn == g_hConnection) {
+        connectStripesLocked();
+      }
       std::cout << "Connected to host" << std::endl;
       // Log connection info
       SteamNetConnectionInfo_t info;
@@ -620,16 +768,23 @@ void SteamNetworkingManager::handleConnectionStatusChanged(
                    k_ESteamNetworkingConnectionState_ClosedByPeer ||
                pInfo->m_info.m_eState ==
                    k_ESteamNetworkingConnectionState_ProblemDetectedLocally) {
-      g_isConnected = false;
-      g_hConnection = k_HSteamNetConnection_Invalid;
-      connectAttemptStart_ = {};
+      if (!hostStripe) {
+        g_isConnected = false;
+        if (pInfo->m_hConn == g_hConnection) {
+          closeStripesLocked();
+        }
+        g_hConnection = k_HSteamNetConnection_Invalid;
+        connectAttemptStart_ = {};
+        hostPing_ = 0;
+      }
       // Remove from connections
       auto it =
           std::find(connections.begin(), connections.end(), pInfo->m_hConn);
       if (it != connections.end()) {
         connections.erase(it);
       }
-      hostPing_ = 0;
+      // Frees Steam's handle and the connection's tunnel state
+      closeTunnelConnection(pInfo->m_hConn, nullptr);
       std::cout << "Connection closed" << std::endl;
     }
   }
@@ -1,6 +1,7 @@
 #ifndef STEAM_NETWORKING_MANAGER_H
 #define STEAM_NETWORKING_MANAGER_H
 
+#include <atomic>
 #include <isteamnetworkingsockets.h>
 #include <isteamnetworkingutils.h>
 #include <map>
@@ -30,6 +31,9 @@ struct UserInfo {
 class SteamNetworkingManager {
 public:
   static SteamNetworkingManager *instance;
+  // Parallel P2P connections (virtual ports 0..N-1) one client may open
+  static constexpr int kMaxTunnelStripes = 4;
+
   SteamNetworkingManager();
   ~SteamNetworkingManager();
 
@@ -40,6 +44,23 @@ public:
   bool joinHost(uint64 hostID);
   void disconnect();
 
+  // Client side: once the primary connection is up, open `stripes` - 1
+  // more on further virtual ports. Each TCP stream is pinned to one of them,
+  // so per-stream ordering holds while bulk transfers spread over several
+  // congestion windows and Steam send-rate limits. Takes effect on the next
+  // join.
+  void setTunnelStripes(int stripes);
+  // Coalesce small TCP writes into '\x03' batch frames. Every peer must run
+  // a build that decodes them; new tunnels pick the value up.
+  void setTunnelBatching(bool enabled) { tunnelBatching_ = enabled; }
+  bool tunnelBatching() const { return tunnelBatching_; }
+  // Host side: accept stripe connections on virtual ports 1..kMaxTunnelStripes-1
+  bool openStripeListenSockets();
+  void closeStripeListenSockets();
+  // Connected connections that may carry a new TCP stream (client side: the
+  // primary plus its stripes)
+  std::vector<HSteamNetConnection> getTunnelStripes();
+
   // Getters
   bool isHost() const { return g_isHost; }
   bool isClient() const { return g_isClient; }
@@ -87,6 +108,11 @@ public:
 
 private:
   bool connectToHostInternal(const CSteamID &hostSteamID, bool relayOnly);
+  void closeTunnelConnection(HSteamNetConnection conn, const char *reason);
+  void connectStripesLocked();
+  void closeStripesLocked();
+  bool isClientStripeLocked(HSteamNetConnection conn) const;
+  bool isHostStripe(HSteamListenSocket listenSocket) const;
 
   // Steam API
   ISteamNetworkingSockets *m_pInterface;
@@ -104,6 +130,14 @@ private:
   std::mutex connectionsMutex;
   int hostPing_; // Ping to host (for clients) or average ping (for host)
 
+  // Client-side extra stripes; g_hConnection stays the primary
+  int tunnelStripes_ = 1;
+  std::atomic<bool> tunnelBatching_{false};
+  bool stripesRelayOnly_ = false;
+  std::vector<HSteamNetConnection> clientStripes_;
+  std::vector<HSteamNetConnection> connectedStripes_;
+  std::vector<HSteamListenSocket> stripeListenSocks_;
+
   // Connection config
   int g_retryCount;
   const int MAX_RETRIES = 3;
@@ -533,6 +533,9 @@ bool SteamRoomManager::startHosting() {
 
   if (networkingManager_->getListenSock() != k_HSteamListenSocket_Invalid) {
     networkingManager_->getIsHost() = true;
+    // Clients that stripe connect on the extra virtual ports; without
+    // them they simply stay on port 0
+    networkingManager_->openStripeListenSockets();
     std::cout << "Created listen socket for hosting game room" << std::endl;
     return true;
   } else {
@@ -548,6 +551,7 @@ void SteamRoomManager::stopHosting() {
         networkingManager_->getListenSock());
     networkingManager_->getListenSock() = k_HSteamListenSocket_Invalid;
   }
+  networkingManager_->closeStripeListenSockets();
   leaveLobby();
   networkingManager_->getIsHost() = false;
 }
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <cstring>
 #include <iostream>
+#include <random>
 #include <thread>
 #include <steam_api.h>
 
@@ -19,12 +20,25 @@ constexpr const char *kDefaultTunName = "SteamVPN";
 constexpr const char *kDefaultSubnet = "10.0.0.0";
 constexpr const char *kDefaultSubnetMask = "255.0.0.0";
 constexpr int kDefaultMtu = 1400;
+constexpr std::chrono::milliseconds kRouteFlushDelay{100};
+// Existing members that send a joiner the full route snapshot
+constexpr size_t kJoinResponders = 2;
+
+uint64_t rendezvousScore(uint64_t member, uint64_t joiner) {
+  uint64_t h = member ^ (joiner * 0x9E3779B97F4A7C15ULL);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
 } // namespace
 
 SteamVpnBridge::SteamVpnBridge(SteamVpnNetworkingManager *steamManager)
     : steamManager_(steamManager), running_(false), baseIP_(0), subnetMask_(0),
       localIP_(0) {
   std::memset(&stats_, 0, sizeof(stats_));
+  ipNegotiator_.setTimerWheel(&timers_);
+  heartbeatManager_.setTimerWheel(&timers_);
 }
 
 SteamVpnBridge::~SteamVpnBridge() { stop(); }
@@ -80,25 +94,52 @@ bool SteamVpnBridge::start(const std::string &tunDeviceName,
   ipNegotiator_.setSuccessCallback([this](uint32_t ip, const NodeID &nodeId) {
     onNegotiationSuccess(ip, nodeId);
   });
+  ipNegotiator_.setPeerListCallback([this]() { return connectedPeers(); });
 
   heartbeatManager_.setSendCallback([this](VpnMessageType type,
                                            const uint8_t *payload, size_t len,
                                            bool reliable) {
     broadcastVpnMessage(type, payload, len, reliable);
   });
+  heartbeatManager_.setGossipCallbacks(
+      [this](VpnMessageType type, const uint8_t *payload, size_t len,
+             CSteamID targetSteamID, bool reliable) {
+        sendVpnMessage(type, payload, len, targetSteamID, reliable);
+      },
+      [this]() { return connectedPeers(); });
   heartbeatManager_.setNodeExpiredCallback(
       [this](const NodeID &nodeId, uint32_t ip) { onNodeExpired(nodeId, ip); });
 
-  ipNegotiator_.startNegotiation();
+  {
+    std::lock_guard<std::mutex> lock(routingMutex_);
+    routeIncarnation_ = std::random_device{}();
+    routeEpoch_ = 0;
+  }
+  timers_.start();
   tunDevice_->set_non_blocking(true);
 
   running_ = true;
   tunReadThread_ =
       std::make_unique<std::thread>(&SteamVpnBridge::tunReadThread, this);
+
+  uint32_t cachedIP = 0;
+  if (!leaseCache_.lookup(leaseScope_, baseIP_, subnetMask_, cachedIP) ||
+      !ipNegotiator_.resumeLease(cachedIP)) {
+    ipNegotiator_.startNegotiation();
+  }
+  if (!running_) {
+    return false; // configuring the cached address failed
+  }
   std::cout << "Steam VPN bridge started successfully" << std::endl;
   return true;
 }
 
+void SteamVpnBridge::setLeaseCachePath(const std::string &path) {
+  leaseCache_.setPath(path);
+}
+
+void SteamVpnBridge::setLeaseScope(uint64_t lobbyId) { leaseScope_ = lobbyId; }
+
 void SteamVpnBridge::stop() {
   if (!running_) {
     return;
@@ -111,9 +152,18 @@ void SteamVpnBridge::stop() {
   if (tunReadThread_ && tunReadThread_->joinable()) {
     tunReadThread_->join();
   }
+  timers_.stop();
+  routeFlushPending_ = false;
+  if (localIP_ != 0) {
+    // Restart the lease from the moment we left
+    leaseCache_.store(leaseScope_, baseIP_, subnetMask_, localIP_,
+                      std::chrono::milliseconds(LEASE_EXPIRY_MS));
+  }
   {
     std::lock_guard<std::mutex> lock(routingMutex_);
     routingTable_.clear();
+    pendingRouteOps_.clear();
+    peerRouteVersions_.clear();
   }
   ipNegotiator_.reset();
   heartbeatManager_.reset();
@@ -143,7 +193,6 @@ std::map<uint32_t, RouteEntry> SteamVpnBridge::getRoutingTable() const {
 void SteamVpnBridge::tunReadThread() {
   std::cout << "TUN read thread started" << std::endl;
   uint8_t buffer[2048];
-  auto lastTimeoutCheck = std::chrono::steady_clock::now();
 
   while (running_) {
     const int bytesRead =
@@ -184,12 +233,12 @@ void SteamVpnBridge::tunReadThread() {
             vpnPacket, vpnPacketSize,
             k_nSteamNetworkingSend_UnreliableNoNagle |
                 k_nSteamNetworkingSend_NoDelay);
-        const auto peers = steamManager_->getPeers();
+        const size_t peerCount = steamManager_->peerSnapshot()->peers.size();
         std::lock_guard<std::mutex> lock(statsMutex_);
-        stats_.packetsSent += peers.size();
-        stats_.bytesSent += static_cast<uint64_t>(bytesRead) * peers.size();
+        stats_.packetsSent += peerCount;
+        stats_.bytesSent += static_cast<uint64_t>(bytesRead) * peerCount;
         std::cout << "[SteamVPN] Broadcast " << ipToString(srcIP) << " -> "
-                  << ipToString(destIP) << " to " << peers.size() << " peers ("
+                  << ipToString(destIP) << " to " << peerCount << " peers ("
                   << bytesRead << " bytes)" << std::endl;
       } else {
         CSteamID targetSteamID;
@@ -211,7 +260,12 @@ void SteamVpnBridge::tunReadThread() {
                       << " bytes)" << std::endl;
           }
         }
-        if (found) {
+        // Unicast to a peer the liveness tracker reports down is dropped
+        // instead of being sent into a dead session; its routes stay until
+        // lease expiry or leave.
+        const bool unreachable =
+            found && steamManager_->isPeerDown(targetSteamID);
+        if (found && !unreachable) {
           steamManager_->sendMessageToUser(
               targetSteamID, vpnPacket, vpnPacketSize,
               k_nSteamNetworkingSend_UnreliableNoNagle |
@@ -223,6 +277,9 @@ void SteamVpnBridge::tunReadThread() {
           //           << ipToString(destIP) << " (" << bytesRead
           //           << " bytes) to " << targetSteamID.ConvertToUint64()
           //           << std::endl;
+        } else if (unreachable) {
+          std::lock_guard<std::mutex> lock(statsMutex_);
+          stats_.packetsDropped++;
         }
       }
     }
@@ -230,14 +287,6 @@ void SteamVpnBridge::tunReadThread() {
       // No packet ready; yield briefly to avoid spinning a full core.
       std::this_thread::sleep_for(std::chrono::milliseconds(2));
     }
-
-    const auto now = std::chrono::steady_clock::now();
-    if (std::chrono::duration_cast<std::chrono::milliseconds>(now -
-                                                              lastTimeoutCheck)
-            .count() >= 50) {
-      lastTimeoutCheck = now;
-      ipNegotiator_.checkTimeout();
-    }
   }
   std::cout << "TUN read thread stopped" << std::endl;
 }
@@ -269,7 +318,7 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
       CSteamID conflicting;
       const uint32_t conflictIP = senderIP != 0 ? senderIP : destIP;
       if (heartbeatManager_.detectConflict(conflictIP, wrapper.senderNodeId,
-                                           conflicting) &&
+                                           senderSteamID, conflicting) &&
           conflicting != senderSteamID) {
         sendVpnMessage(VpnMessageType::FORCED_RELEASE, payload, payloadLength,
                        conflicting, true);
@@ -308,34 +357,35 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
       uint32_t ipAddress = 0;
       std::memcpy(&steamID, payload + offset, 8);
       std::memcpy(&ipAddress, payload + offset + 8, 4);
-      ipAddress = ntohl(ipAddress);
       offset += 12;
-
-      CSteamID csteamID(static_cast<uint64>(steamID));
-      if (SteamUser() && csteamID == SteamUser()->GetSteamID()) {
-        continue;
-      }
-      {
-        std::lock_guard<std::mutex> lock(routingMutex_);
-        if (routingTable_.find(ipAddress) != routingTable_.end()) {
-          continue;
-        }
-      }
-      if ((ipAddress & subnetMask_) == (baseIP_ & subnetMask_)) {
-        NodeID nodeId = NodeIdentity::generate(csteamID);
-        updateRoute(nodeId, csteamID, ipAddress,
-                    SteamFriends()
-                        ? SteamFriends()->GetFriendPersonaName(csteamID)
-                        : "");
-      }
+      applyLearnedRoute(CSteamID(static_cast<uint64>(steamID)),
+                        ntohl(ipAddress));
     }
     break;
   }
+  case VpnMessageType::ROUTE_DELTA:
+    handleRouteDelta(payload, payloadLength, senderSteamID);
+    break;
+  case VpnMessageType::ROUTE_SNAPSHOT:
+    handleRouteSnapshot(payload, payloadLength, senderSteamID);
+    break;
+  case VpnMessageType::ROUTE_SNAPSHOT_REQUEST:
+    sendRouteSnapshot(&senderSteamID);
+    break;
   case VpnMessageType::PROBE_REQUEST: {
     if (payloadLength >= sizeof(ProbeRequestPayload)) {
       ProbeRequestPayload request{};
       std::memcpy(&request, payload, sizeof(ProbeRequestPayload));
-      ipNegotiator_.handleProbeRequest(request, senderSteamID);
+      std::vector<uint32_t> extraCandidates;
+      for (size_t offset = sizeof(ProbeRequestPayload);
+           offset + sizeof(uint32_t) <= payloadLength &&
+           extraCandidates.size() + 1 < MAX_PROBE_CANDIDATES;
+           offset += sizeof(uint32_t)) {
+        uint32_t ip = 0;
+        std::memcpy(&ip, payload + offset, sizeof(ip));
+        extraCandidates.push_back(ntohl(ip));
+      }
+      ipNegotiator_.handleProbeRequest(request, extraCandidates, senderSteamID);
     }
     break;
   }
@@ -347,20 +397,35 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
     }
     break;
   }
+  case VpnMessageType::PROBE_ACK: {
+    if (payloadLength >= sizeof(ProbeAckPayload)) {
+      ProbeAckPayload ack{};
+      std::memcpy(&ack, payload, sizeof(ProbeAckPayload));
+      ipNegotiator_.handleProbeAck(ack, senderSteamID);
+    }
+    break;
+  }
   case VpnMessageType::ADDRESS_ANNOUNCE: {
     if (payloadLength >= sizeof(AddressAnnouncePayload)) {
       AddressAnnouncePayload announce{};
       std::memcpy(&announce, payload, sizeof(AddressAnnouncePayload));
       const uint32_t announcedIP = ntohl(announce.ipAddress);
-      bool isNewRoute = false;
-      {
+      const bool resumed =
+          payloadLength > sizeof(AddressAnnouncePayload) &&
+          (payload[sizeof(AddressAnnouncePayload)] & ANNOUNCE_FLAG_RESUMED);
+      bool heldByOther = false;
+      if (resumed) {
+        // A resumed claim does not take over an address someone holds
         std::lock_guard<std::mutex> lock(routingMutex_);
-        isNewRoute = routingTable_.find(announcedIP) == routingTable_.end();
+        auto it = routingTable_.find(announcedIP);
+        heldByOther =
+            it != routingTable_.end() && it->second.steamID != senderSteamID;
       }
-      ipNegotiator_.handleAddressAnnounce(announce, senderSteamID, peerName);
-      updateRoute(announce.nodeId, senderSteamID, announcedIP, peerName);
-      if (isNewRoute) {
-        broadcastRouteUpdate();
+      ipNegotiator_.handleAddressAnnounce(announce, resumed, senderSteamID,
+                                          peerName);
+      // Not re-gossiped: the owner announces to every peer itself
+      if (!heldByOther) {
+        updateRoute(announce.nodeId, senderSteamID, announcedIP, peerName);
       }
     }
     break;
@@ -373,11 +438,26 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
     }
     break;
   }
-  case VpnMessageType::HEARTBEAT: {
+  case VpnMessageType::HEARTBEAT:
+  case VpnMessageType::HEARTBEAT_ACK: {
     if (payloadLength >= sizeof(HeartbeatPayload)) {
       HeartbeatPayload heartbeat{};
       std::memcpy(&heartbeat, payload, sizeof(HeartbeatPayload));
       heartbeatManager_.handleHeartbeat(heartbeat, senderSteamID, peerName);
+      if (payloadLength > sizeof(HeartbeatPayload)) {
+        heartbeatManager_.handleGossip(
+            payload + sizeof(HeartbeatPayload),
+            payloadLength - sizeof(HeartbeatPayload), senderSteamID,
+            header.type == VpnMessageType::HEARTBEAT_ACK);
+      }
+    }
+    break;
+  }
+  case VpnMessageType::HEARTBEAT_PING_REQ: {
+    if (payloadLength >= sizeof(HeartbeatPingReqPayload)) {
+      HeartbeatPingReqPayload request{};
+      std::memcpy(&request, payload, sizeof(HeartbeatPingReqPayload));
+      heartbeatManager_.handlePingRequest(request, senderSteamID);
     }
     break;
   }
@@ -391,21 +471,61 @@ void SteamVpnBridge::onUserJoined(CSteamID steamID) {
     std::cout << "[SteamVPN] New peer joined, sending address/route: "
               << steamID.ConvertToUint64() << std::endl;
     ipNegotiator_.sendAddressAnnounceTo(steamID);
-    sendRouteUpdateTo(steamID);
+    // Every owner announces itself; the learned routes only need to come
+    // from a couple of members
+    if (isJoinResponder(steamID)) {
+      sendRouteSnapshot(&steamID);
+    }
+  }
+}
+
+std::set<CSteamID> SteamVpnBridge::connectedPeers() const {
+  std::set<CSteamID> connected;
+  const auto snapshot = steamManager_->peerSnapshot();
+  for (const CSteamID &peer : snapshot->peers) {
+    if (steamManager_->isPeerConnected(peer)) {
+      connected.insert(peer);
+    }
+  }
+  return connected;
+}
+
+bool SteamVpnBridge::isJoinResponder(CSteamID joiner) const {
+  const uint64_t joinerId = joiner.ConvertToUint64();
+  const uint64_t ownScore =
+      rendezvousScore(SteamUser()->GetSteamID().ConvertToUint64(), joinerId);
+  size_t outranked = 0;
+  const auto snapshot = steamManager_->peerSnapshot();
+  for (const CSteamID &peer : snapshot->peers) {
+    if (peer == joiner) {
+      continue;
+    }
+    if (rendezvousScore(peer.ConvertToUint64(), joinerId) > ownScore &&
+        ++outranked >= kJoinResponders) {
+      return false;
+    }
   }
+  return true;
 }
 
 void SteamVpnBridge::onUserLeft(CSteamID steamID) {
   std::lock_guard<std::mutex> lock(routingMutex_);
+  bool removed = false;
   for (auto it = routingTable_.begin(); it != routingTable_.end();) {
     if (it->second.steamID == steamID) {
       heartbeatManager_.unregisterNode(it->second.nodeId);
       ipNegotiator_.markIPUnused(it->first);
+      queueRouteOpLocked(ROUTE_OP_REMOVE, steamID, it->first);
+      removed = true;
       it = routingTable_.erase(it);
     } else {
       ++it;
     }
   }
+  peerRouteVersions_.erase(steamID);
+  if (removed) {
+    scheduleRouteFlush();
+  }
   if (SteamUser() && steamID == SteamUser()->GetSteamID()) {
     running_ = false;
     heartbeatManager_.stop();
@@ -427,7 +547,8 @@ void SteamVpnBridge::rebroadcastState() {
   }
   std::cout << "[SteamVPN] Rebroadcasting address and routes" << std::endl;
   ipNegotiator_.sendAddressAnnounce();
-  broadcastRouteUpdate();
+  flushRouteDeltas();
+  sendRouteSnapshot(nullptr);
 }
 
 void SteamVpnBridge::onNegotiationSuccess(uint32_t ipAddress,
@@ -455,7 +576,13 @@ void SteamVpnBridge::onNegotiationSuccess(uint32_t ipAddress,
         nodeId, mySteamID, localIP_,
         SteamFriends() ? SteamFriends()->GetPersonaName() : "");
     heartbeatManager_.start();
-    broadcastRouteUpdate();
+    leaseCache_.store(leaseScope_, baseIP_, subnetMask_, localIP_,
+                      std::chrono::milliseconds(LEASE_EXPIRY_MS));
+    {
+      std::lock_guard<std::mutex> lock(routingMutex_);
+      queueRouteOpLocked(ROUTE_OP_ADD, mySteamID, localIP_);
+    }
+    flushRouteDeltas();
   } else {
     std::cerr << "Failed to configure TUN device IP." << std::endl;
     stop();
@@ -493,48 +620,81 @@ void SteamVpnBridge::updateRoute(const NodeID &nodeId, CSteamID steamId,
 }
 
 void SteamVpnBridge::removeRoute(uint32_t ipAddress) {
-  std::lock_guard<std::mutex> lock(routingMutex_);
-  routingTable_.erase(ipAddress);
+  {
+    std::lock_guard<std::mutex> lock(routingMutex_);
+    auto it = routingTable_.find(ipAddress);
+    if (it == routingTable_.end()) {
+      return;
+    }
+    queueRouteOpLocked(ROUTE_OP_REMOVE, it->second.steamID, ipAddress);
+    routingTable_.erase(it);
+  }
+  scheduleRouteFlush();
 }
 
-void SteamVpnBridge::broadcastRouteUpdate() {
-  std::vector<uint8_t> message;
-  std::vector<uint8_t> routeData;
+void SteamVpnBridge::queueRouteOpLocked(uint8_t op, CSteamID steamId,
+                                        uint32_t ipAddress) {
+  RouteOpEntry entry{};
+  entry.op = op;
+  entry.steamId = steamId.ConvertToUint64();
+  entry.ipAddress = htonl(ipAddress);
+  pendingRouteOps_.push_back(entry);
+}
 
+void SteamVpnBridge::flushRouteDeltas() {
+  std::lock_guard<std::mutex> sendLock(routeSendMutex_);
+  std::vector<std::vector<uint8_t>> payloads;
   {
     std::lock_guard<std::mutex> lock(routingMutex_);
-    for (const auto &entry : routingTable_) {
-      const uint64_t steamID = entry.second.steamID.ConvertToUint64();
-      const uint32_t ipAddress = htonl(entry.second.ipAddress);
-      const size_t offset = routeData.size();
-      routeData.resize(offset + 12);
-      std::memcpy(routeData.data() + offset, &steamID, 8);
-      std::memcpy(routeData.data() + offset + 8, &ipAddress, 4);
+    for (size_t first = 0; first < pendingRouteOps_.size();
+         first += MAX_ROUTE_ENTRIES_PER_MESSAGE) {
+      const size_t count = std::min(pendingRouteOps_.size() - first,
+                                    MAX_ROUTE_ENTRIES_PER_MESSAGE);
+      RouteDeltaHeader header{};
+      header.incarnation = htonl(routeIncarnation_);
+      header.baseEpoch = htonl(routeEpoch_);
+      header.epoch = htonl(++routeEpoch_);
+      std::vector<uint8_t> payload(sizeof(header) +
+                                   count * sizeof(RouteOpEntry));
+      std::memcpy(payload.data(), &header, sizeof(header));
+      std::memcpy(payload.data() + sizeof(header),
+                  pendingRouteOps_.data() + first,
+                  count * sizeof(RouteOpEntry));
+      payloads.push_back(std::move(payload));
     }
+    pendingRouteOps_.clear();
   }
+  for (const auto &payload : payloads) {
+    std::cout << "[SteamVPN] Broadcasting route delta with "
+              << (payload.size() - sizeof(RouteDeltaHeader)) /
+                     sizeof(RouteOpEntry)
+              << " changes" << std::endl;
+    broadcastVpnMessage(VpnMessageType::ROUTE_DELTA, payload.data(),
+                        payload.size(), true);
+  }
+}
 
-  VpnMessageHeader header{};
-  header.type = VpnMessageType::ROUTE_UPDATE;
-  header.length = htons(static_cast<uint16_t>(routeData.size()));
-
-  message.resize(sizeof(VpnMessageHeader) + routeData.size());
-  std::memcpy(message.data(), &header, sizeof(VpnMessageHeader));
-  if (!routeData.empty()) {
-    std::memcpy(message.data() + sizeof(VpnMessageHeader), routeData.data(),
-                routeData.size());
+void SteamVpnBridge::scheduleRouteFlush() {
+  if (routeFlushPending_.exchange(true)) {
+    return;
   }
-  std::cout << "[SteamVPN] Broadcasting route update with "
-            << (routeData.size() / 12) << " entries" << std::endl;
-  steamManager_->broadcastMessage(message.data(),
-                                  static_cast<uint32_t>(message.size()),
-                                  k_nSteamNetworkingSend_Reliable);
+  timers_.schedule(kRouteFlushDelay, [this]() {
+    routeFlushPending_ = false;
+    if (running_) {
+      flushRouteDeltas();
+    }
+  });
 }
 
-void SteamVpnBridge::sendRouteUpdateTo(CSteamID targetSteamID) {
-  std::vector<uint8_t> message;
+void SteamVpnBridge::sendRouteSnapshot(const CSteamID *targetSteamID) {
+  std::lock_guard<std::mutex> sendLock(routeSendMutex_);
   std::vector<uint8_t> routeData;
+  RouteSnapshotHeader header{};
   {
     std::lock_guard<std::mutex> lock(routingMutex_);
+    header.incarnation = htonl(routeIncarnation_);
+    header.epoch = htonl(routeEpoch_);
+    routeData.reserve(routingTable_.size() * 12);
     for (const auto &entry : routingTable_) {
       const uint64_t steamID = entry.second.steamID.ConvertToUint64();
       const uint32_t ipAddress = htonl(entry.second.ipAddress);
@@ -545,22 +705,157 @@ void SteamVpnBridge::sendRouteUpdateTo(CSteamID targetSteamID) {
     }
   }
 
-  VpnMessageHeader header{};
-  header.type = VpnMessageType::ROUTE_UPDATE;
-  header.length = htons(static_cast<uint16_t>(routeData.size()));
+  // Snapshots only add routes, so a large table is simply split up; a
+  // removal they miss ages out with the route's lease
+  const size_t chunkBytes = MAX_ROUTE_ENTRIES_PER_MESSAGE * 12;
+  size_t offset = 0;
+  do {
+    const size_t count = std::min(routeData.size() - offset, chunkBytes);
+    std::vector<uint8_t> payload(sizeof(header) + count);
+    std::memcpy(payload.data(), &header, sizeof(header));
+    if (count > 0) {
+      std::memcpy(payload.data() + sizeof(header), routeData.data() + offset,
+                  count);
+    }
+    if (targetSteamID) {
+      sendVpnMessage(VpnMessageType::ROUTE_SNAPSHOT, payload.data(),
+                     payload.size(), *targetSteamID, true);
+    } else {
+      broadcastVpnMessage(VpnMessageType::ROUTE_SNAPSHOT, payload.data(),
+                          payload.size(), true);
+    }
+    offset += count;
+  } while (offset < routeData.size());
+  std::cout << "[SteamVPN] Sent route snapshot with "
+            << (routeData.size() / 12) << " entries" << std::endl;
+}
 
-  message.resize(sizeof(VpnMessageHeader) + routeData.size());
-  std::memcpy(message.data(), &header, sizeof(VpnMessageHeader));
-  if (!routeData.empty()) {
-    std::memcpy(message.data() + sizeof(VpnMessageHeader), routeData.data(),
-                routeData.size());
+void SteamVpnBridge::handleRouteDelta(const uint8_t *payload, size_t length,
+                                      CSteamID senderSteamID) {
+  if (length < sizeof(RouteDeltaHeader)) {
+    return;
   }
-  std::cout << "[SteamVPN] Sending route update to "
-            << targetSteamID.ConvertToUint64() << " with "
-            << (routeData.size() / 12) << " entries" << std::endl;
-  steamManager_->sendMessageToUser(targetSteamID, message.data(),
-                                   static_cast<uint32_t>(message.size()),
-                                   k_nSteamNetworkingSend_Reliable);
+  RouteDeltaHeader header{};
+  std::memcpy(&header, payload, sizeof(header));
+  const uint32_t incarnation = ntohl(header.incarnation);
+  const uint32_t baseEpoch = ntohl(header.baseEpoch);
+  const uint32_t epoch = ntohl(header.epoch);
+
+  bool requestSnapshot = false;
+  {
+    std::lock_guard<std::mutex> lock(routingMutex_);
+    PeerRouteVersion &version = peerRouteVersions_[senderSteamID];
+    const bool sameHistory =
+        version.synced && version.incarnation == incarnation;
+    if (!version.synced || (sameHistory && version.epoch == baseEpoch) ||
+        (!sameHistory && baseEpoch == 0)) {
+      // A sender's first delta is our baseline: what it knew before came
+      // from the owners' announces and the join responders' snapshots.
+      // Epoch 0 after a restart is an empty history.
+      version.incarnation = incarnation;
+      version.epoch = epoch;
+      version.synced = true;
+      version.snapshotRequested = false;
+    } else if (sameHistory && epoch <= version.epoch) {
+      return; // already covered by a snapshot
+    } else {
+      // Gap: adds and owner-checked removes are idempotent, so apply this
+      // delta anyway and let the snapshot fill in what was missed
+      requestSnapshot = !version.snapshotRequested;
+      version.snapshotRequested = true;
+    }
+  }
+  if (requestSnapshot) {
+    std::cout << "[SteamVPN] Route epoch gap from "
+              << senderSteamID.ConvertToUint64() << ", requesting snapshot"
+              << std::endl;
+    sendVpnMessage(VpnMessageType::ROUTE_SNAPSHOT_REQUEST, nullptr, 0,
+                   senderSteamID, true);
+  }
+
+  for (size_t offset = sizeof(RouteDeltaHeader);
+       offset + sizeof(RouteOpEntry) <= length;
+       offset += sizeof(RouteOpEntry)) {
+    RouteOpEntry entry{};
+    std::memcpy(&entry, payload + offset, sizeof(entry));
+    const CSteamID steamId(static_cast<uint64>(entry.steamId));
+    if (entry.op == ROUTE_OP_ADD) {
+      applyLearnedRoute(steamId, ntohl(entry.ipAddress));
+    } else if (entry.op == ROUTE_OP_REMOVE) {
+      removeLearnedRoute(steamId, ntohl(entry.ipAddress));
+    }
+  }
+}
+
+void SteamVpnBridge::handleRouteSnapshot(const uint8_t *payload,
+                                         size_t length,
+                                         CSteamID senderSteamID) {
+  if (length < sizeof(RouteSnapshotHeader)) {
+    return;
+  }
+  RouteSnapshotHeader header{};
+  std::memcpy(&header, payload, sizeof(header));
+  const uint32_t incarnation = ntohl(header.incarnation);
+  const uint32_t epoch = ntohl(header.epoch);
+
+  for (size_t offset = sizeof(header); offset + 12 <= length; offset += 12) {
+    uint64_t steamID = 0;
+    uint32_t ipAddress = 0;
+    std::memcpy(&steamID, payload + offset, 8);
+    std::memcpy(&ipAddress, payload + offset + 8, 4);
+    applyLearnedRoute(CSteamID(static_cast<uint64>(steamID)),
+                      ntohl(ipAddress));
+  }
+
+  std::lock_guard<std::mutex> lock(routingMutex_);
+  PeerRouteVersion &version = peerRouteVersions_[senderSteamID];
+  if (!version.synced || version.incarnation != incarnation ||
+      epoch > version.epoch) {
+    version.incarnation = incarnation;
+    version.epoch = epoch;
+  }
+  version.synced = true;
+  version.snapshotRequested = false;
+}
+
+void SteamVpnBridge::applyLearnedRoute(CSteamID steamId, uint32_t ipAddress) {
+  if (SteamUser() && steamId == SteamUser()->GetSteamID()) {
+    return;
+  }
+  if ((ipAddress & subnetMask_) != (baseIP_ & subnetMask_)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(routingMutex_);
+    if (routingTable_.find(ipAddress) != routingTable_.end()) {
+      return;
+    }
+  }
+  const NodeID nodeId = NodeIdentity::generate(steamId);
+  const std::string name =
+      SteamFriends() ? SteamFriends()->GetFriendPersonaName(steamId) : "";
+  updateRoute(nodeId, steamId, ipAddress, name);
+  // Leased like any other node: the owner's heartbeats keep the route, and
+  // it expires if a removal never reaches us
+  heartbeatManager_.registerNode(nodeId, steamId, ipAddress, name);
+}
+
+void SteamVpnBridge::removeLearnedRoute(CSteamID steamId, uint32_t ipAddress) {
+  // A peer we still reach directly keeps its route whatever others saw
+  if (steamManager_ && steamManager_->isPeerConnected(steamId)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(routingMutex_);
+    auto it = routingTable_.find(ipAddress);
+    if (it == routingTable_.end() || it->second.isLocal ||
+        it->second.steamID != steamId) {
+      return;
+    }
+    routingTable_.erase(it);
+  }
+  heartbeatManager_.unregisterNode(NodeIdentity::generate(steamId));
+  ipNegotiator_.markIPUnused(ipAddress);
 }
 
 void SteamVpnBridge::sendVpnMessage(VpnMessageType type, const uint8_t *payload,
@@ -2,12 +2,15 @@
 
 #include "../net/heartbeat_manager.h"
 #include "../net/ip_negotiator.h"
+#include "../net/lease_cache.h"
+#include "../net/timer_wheel.h"
 #include "../net/vpn_protocol.h"
 #include "../tun/tun_interface.h"
 #include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
@@ -26,6 +29,12 @@ public:
 
   bool isRunning() const { return running_; }
 
+  // Addresses are cached per lobby so a rejoin reclaims the previous one
+  // and configures the TUN device without waiting for negotiation. Scope 0
+  // (e.g. hosting a lobby that does not exist yet) skips the cache.
+  void setLeaseCachePath(const std::string &path);
+  void setLeaseScope(uint64_t lobbyId);
+
   std::string getLocalIP() const;
   std::string getTunDeviceName() const;
   std::map<uint32_t, RouteEntry> getRoutingTable() const;
@@ -61,13 +70,32 @@ private:
   void broadcastVpnMessage(VpnMessageType type, const uint8_t *payload,
                            size_t payloadLength, bool reliable = true);
 
+  std::set<CSteamID> connectedPeers() const;
+  // Rendezvous-hashes the joiner against every member so only a few fixed
+  // nodes push route snapshots to it, instead of the whole room.
+  bool isJoinResponder(CSteamID joiner) const;
+
   void onNegotiationSuccess(uint32_t ipAddress, const NodeID &nodeId);
   void onNodeExpired(const NodeID &nodeId, uint32_t ipAddress);
   void updateRoute(const NodeID &nodeId, CSteamID steamId, uint32_t ipAddress,
                    const std::string &name);
   void removeRoute(uint32_t ipAddress);
-  void broadcastRouteUpdate();
-  void sendRouteUpdateTo(CSteamID targetSteamID);
+
+  // Only first-hand changes (our own address, leaves and expiries) are
+  // queued. Owners' announces reach every peer directly and routes learned
+  // from other peers' route messages are applied without being re-gossiped.
+  void queueRouteOpLocked(uint8_t op, CSteamID steamId, uint32_t ipAddress);
+  // Sends queued ops as ROUTE_DELTA, one epoch per message.
+  void flushRouteDeltas();
+  // Coalesces back-to-back route changes into one delta.
+  void scheduleRouteFlush();
+  void sendRouteSnapshot(const CSteamID *targetSteamID);
+  void handleRouteDelta(const uint8_t *payload, size_t length,
+                        CSteamID senderSteamID);
+  void handleRouteSnapshot(const uint8_t *payload, size_t length,
+                           CSteamID senderSteamID);
+  void applyLearnedRoute(CSteamID steamId, uint32_t ipAddress);
+  void removeLearnedRoute(CSteamID steamId, uint32_t ipAddress);
 
   SteamVpnNetworkingManager *steamManager_;
   std::unique_ptr<tun::TunInterface> tunDevice_;
@@ -77,6 +105,20 @@ private:
   std::map<uint32_t, RouteEntry> routingTable_;
   mutable std::mutex routingMutex_;
 
+  // Route versioning, guarded by routingMutex_
+  struct PeerRouteVersion {
+    uint32_t incarnation = 0;
+    uint32_t epoch = 0;
+    bool synced = false;
+    bool snapshotRequested = false;
+  };
+  uint32_t routeIncarnation_ = 0;
+  uint32_t routeEpoch_ = 0;
+  std::vector<RouteOpEntry> pendingRouteOps_;
+  std::map<CSteamID, PeerRouteVersion> peerRouteVersions_;
+  // Keeps deltas and snapshots on the wire in epoch order
+  std::mutex routeSendMutex_;
+
   uint32_t baseIP_;
   uint32_t subnetMask_;
   uint32_t localIP_;
@@ -84,6 +126,16 @@ private:
   Statistics stats_;
   mutable std::mutex statsMutex_;
 
+  // Control-plane timers (probe timeouts, heartbeats, leases, debounces).
+  // stop(), also run by the destructor, stops the wheel before
+  // ipNegotiator_ and heartbeatManager_ go away, so none of their callbacks
+  // can fire on a destroyed component.
+  TimerWheel timers_;
+  std::atomic<bool> routeFlushPending_{false};
+
+  LeaseCache leaseCache_;
+  std::atomic<uint64_t> leaseScope_{0};
+
   IpNegotiator ipNegotiator_;
   HeartbeatManager heartbeatManager_;
 };
@@ -51,8 +51,13 @@ long long unixTimeSeconds() {
 }
 } // namespace
 
+bool SteamVpnNetworkingManager::PeerSnapshot::contains(CSteamID peerID) const {
+  return std::binary_search(peers.begin(), peers.end(), peerID);
+}
+
 SteamVpnNetworkingManager::SteamVpnNetworkingManager()
-    : messagesInterface_(nullptr), messageHandler_(nullptr),
+    : messagesInterface_(nullptr),
+      peers_(std::make_shared<const PeerSnapshot>()), messageHandler_(nullptr),
       vpnBridge_(nullptr) {}
 
 SteamVpnNetworkingManager::~SteamVpnNetworkingManager() {
@@ -123,15 +128,17 @@ bool SteamVpnNetworkingManager::initialize() {
 void SteamVpnNetworkingManager::shutdown() {
   {
     std::lock_guard<std::mutex> lock(peersMutex_);
-    for (const auto &peer : peers_) {
+    const auto snapshot = peerSnapshot();
+    for (const auto &peer : snapshot->peers) {
       SteamNetworkingIdentity identity;
       identity.SetSteamID(peer);
       if (messagesInterface_) {
         messagesInterface_->CloseSessionWithUser(identity);
       }
     }
-    peers_.clear();
+    publishPeersLocked({});
   }
+  liveness_.clear();
   hostSteamID_ = CSteamID();
 }
 
@@ -153,8 +160,14 @@ void SteamVpnNetworkingManager::broadcastMessage(const void *data,
   if (!messagesInterface_) {
     return;
   }
-  std::lock_guard<std::mutex> lock(peersMutex_);
-  for (const auto &peerID : peers_) {
+  // Unreliable traffic to a peer that is down would only be dropped later
+  const bool skipDown =
+      (flags & k_nSteamNetworkingSend_Reliable) == 0 && liveness_.anyDown();
+  const auto snapshot = peerSnapshot();
+  for (const auto &peerID : snapshot->peers) {
+    if (skipDown && liveness_.isDown(peerID)) {
+      continue;
+    }
     SteamNetworkingIdentity identity;
     identity.SetSteamID(peerID);
     messagesInterface_->SendMessageToUser(identity, data, size, flags,
@@ -169,46 +182,31 @@ void SteamVpnNetworkingManager::addPeer(CSteamID peerID) {
   if (SteamUser() && peerID == SteamUser()->GetSteamID()) {
     return;
   }
-  bool isNew = false;
+  const bool broken = isSessionBroken(peerID);
   {
     std::lock_guard<std::mutex> lock(peersMutex_);
-    isNew = peers_.insert(peerID).second;
+    const auto snapshot = peerSnapshot();
+    if (snapshot->contains(peerID)) {
+      if (!broken) {
+        return; // healthy or still connecting; nothing to redo
+      }
+    } else {
+      std::vector<CSteamID> peers = snapshot->peers;
+      peers.insert(std::upper_bound(peers.begin(), peers.end(), peerID),
+                   peerID);
+      publishPeersLocked(std::move(peers));
+    }
   }
-  // Force a fresh session even if we already know this peer, so reconnects
-  // after a leave/rejoin can renegotiate cleanly.
+  liveness_.track(peerID, PeerLiveness::Clock::now());
   SteamNetworkingIdentity identity;
   identity.SetSteamID(peerID);
-  messagesInterface_->CloseSessionWithUser(identity);
-  messagesInterface_->AcceptSessionWithUser(identity);
-  VpnMessageHeader hello{};
-  hello.type = VpnMessageType::SESSION_HELLO;
-  SessionHelloPayload payload{};
-  std::memset(&payload, 0, sizeof(payload));
-  if (!localVersion_.empty()) {
-    const size_t maxLen = VPN_VERSION_MAX_LEN - 1;
-    const size_t copyLen = std::min(localVersion_.size(), maxLen);
-    std::memcpy(payload.version, localVersion_.data(), copyLen);
-    payload.version[copyLen] = '\0';
-  }
-  payload.capabilities = 0;
-  payload.capabilities |= VPN_CAP_PASSWORD;
-  hello.length = htons(static_cast<uint16_t>(sizeof(SessionHelloPayload)));
-  uint8_t buffer[sizeof(VpnMessageHeader) + sizeof(SessionHelloPayload)];
-  std::memcpy(buffer, &hello, sizeof(VpnMessageHeader));
-  std::memcpy(buffer + sizeof(VpnMessageHeader), &payload,
-              sizeof(SessionHelloPayload));
-  const int flags = k_nSteamNetworkingSend_Reliable |
-                    k_nSteamNetworkingSend_AutoRestartBrokenSession;
-  const EResult result = messagesInterface_->SendMessageToUser(
-      identity, buffer, sizeof(buffer), flags, VPN_CHANNEL);
-  if (result == k_EResultOK) {
-    std::cout << "[SteamVPN] Sent SESSION_HELLO to "
-              << peerID.ConvertToUint64() << std::endl;
-  } else {
-    std::cout << "[SteamVPN] Failed to send SESSION_HELLO to "
-              << peerID.ConvertToUint64() << ", result: " << result
-              << std::endl;
+  // Only a dead session is torn down; a live one (e.g. the peer reached us
+  // first) is kept and simply greeted.
+  if (broken) {
+    messagesInterface_->CloseSessionWithUser(identity);
   }
+  messagesInterface_->AcceptSessionWithUser(identity);
+  sendSessionHello(peerID);
   if (vpnBridge_) {
     vpnBridge_->onUserJoined(peerID);
   }
@@ -218,9 +216,16 @@ void SteamVpnNetworkingManager::removePeer(CSteamID peerID) {
   bool removed = false;
   {
     std::lock_guard<std::mutex> lock(peersMutex_);
-    removed = peers_.erase(peerID) > 0;
+    const auto snapshot = peerSnapshot();
+    if (snapshot->contains(peerID)) {
+      std::vector<CSteamID> peers = snapshot->peers;
+      peers.erase(std::lower_bound(peers.begin(), peers.end(), peerID));
+      publishPeersLocked(std::move(peers));
+      removed = true;
+    }
   }
   if (removed) {
+    liveness_.forget(peerID);
     SteamNetworkingIdentity identity;
     identity.SetSteamID(peerID);
     if (messagesInterface_) {
@@ -233,8 +238,14 @@ void SteamVpnNetworkingManager::removePeer(CSteamID peerID) {
 }
 
 void SteamVpnNetworkingManager::clearPeers() {
-  std::lock_guard<std::mutex> lock(peersMutex_);
-  for (const auto &peerID : peers_) {
+  std::shared_ptr<const PeerSnapshot> previous;
+  {
+    std::lock_guard<std::mutex> lock(peersMutex_);
+    previous = peerSnapshot();
+    publishPeersLocked({});
+  }
+  liveness_.clear();
+  for (const auto &peerID : previous->peers) {
     SteamNetworkingIdentity identity;
     identity.SetSteamID(peerID);
     if (messagesInterface_) {
@@ -244,31 +255,80 @@ void SteamVpnNetworkingManager::clearPeers() {
       vpnBridge_->onUserLeft(peerID);
     }
   }
-  peers_.clear();
 }
 
 void SteamVpnNetworkingManager::syncPeers(
     const std::set<CSteamID> &desiredPeers) {
-  std::set<CSteamID> current;
-  {
-    std::lock_guard<std::mutex> lock(peersMutex_);
-    current = peers_;
-  }
+  const auto current = peerSnapshot();
   for (const auto &peer : desiredPeers) {
-    if (current.find(peer) == current.end()) {
+    if (!current->contains(peer)) {
       addPeer(peer);
     }
   }
-  for (const auto &peer : current) {
+  for (const auto &peer : current->peers) {
     if (desiredPeers.find(peer) == desiredPeers.end()) {
       removePeer(peer);
     }
   }
 }
 
-std::set<CSteamID> SteamVpnNetworkingManager::getPeers() const {
-  std::lock_guard<std::mutex> lock(peersMutex_);
-  return peers_;
+std::shared_ptr<const SteamVpnNetworkingManager::PeerSnapshot>
+SteamVpnNetworkingManager::peerSnapshot() const {
+  return std::atomic_load(&peers_);
+}
+
+void SteamVpnNetworkingManager::publishPeersLocked(
+    std::vector<CSteamID> peers) {
+  auto next = std::make_shared<PeerSnapshot>();
+  next->generation = peerSnapshot()->generation + 1;
+  next->peers = std::move(peers);
+  std::atomic_store(&peers_, std::shared_ptr<const PeerSnapshot>(next));
+}
+
+bool SteamVpnNetworkingManager::isSessionBroken(CSteamID peerID) const {
+  if (!messagesInterface_) {
+    return false;
+  }
+  SteamNetworkingIdentity identity;
+  identity.SetSteamID(peerID);
+  const ESteamNetworkingConnectionState state =
+      messagesInterface_->GetSessionConnectionInfo(identity, nullptr, nullptr);
+  return state == k_ESteamNetworkingConnectionState_ClosedByPeer ||
+         state == k_ESteamNetworkingConnectionState_ProblemDetectedLocally;
+}
+
+void SteamVpnNetworkingManager::sendSessionHello(CSteamID peerID) {
+  VpnMessageHeader hello{};
+  hello.type = VpnMessageType::SESSION_HELLO;
+  SessionHelloPayload payload{};
+  std::memset(&payload, 0, sizeof(payload));
+  if (!localVersion_.empty()) {
+    const size_t maxLen = VPN_VERSION_MAX_LEN - 1;
+    const size_t copyLen = std::min(localVersion_.size(), maxLen);
+    std::memcpy(payload.version, localVersion_.data(), copyLen);
+    payload.version[copyLen] = '\0';
+  }
+  payload.capabilities = 0;
+  payload.capabilities |= VPN_CAP_PASSWORD;
+  hello.length = htons(static_cast<uint16_t>(sizeof(SessionHelloPayload)));
+  uint8_t buffer[sizeof(VpnMessageHeader) + sizeof(SessionHelloPayload)];
+  std::memcpy(buffer, &hello, sizeof(VpnMessageHeader));
+  std::memcpy(buffer + sizeof(VpnMessageHeader), &payload,
+              sizeof(SessionHelloPayload));
+  SteamNetworkingIdentity identity;
+  identity.SetSteamID(peerID);
+  const int flags = k_nSteamNetworkingSend_Reliable |
+                    k_nSteamNetworkingSend_AutoRestartBrokenSession;
+  const EResult result = messagesInterface_->SendMessageToUser(
+      identity, buffer, sizeof(buffer), flags, VPN_CHANNEL);
+  if (result == k_EResultOK) {
+    std::cout << "[SteamVPN] Sent SESSION_HELLO to "
+              << peerID.ConvertToUint64() << std::endl;
+  } else {
+    std::cout << "[SteamVPN] Failed to send SESSION_HELLO to "
+              << peerID.ConvertToUint64() << ", result: " << result
+              << std::endl;
+  }
 }
 
 int SteamVpnNetworkingManager::getPeerPing(CSteamID peerID) const {
@@ -397,8 +457,15 @@ void SteamVpnNetworkingManager::handleSessionHello(const uint8_t *data,
   if (blocked) {
     {
       std::lock_guard<std::mutex> lock(peersMutex_);
-      peers_.erase(senderSteamID);
+      const auto snapshot = peerSnapshot();
+      if (snapshot->contains(senderSteamID)) {
+        std::vector<CSteamID> peers = snapshot->peers;
+        peers.erase(
+            std::lower_bound(peers.begin(), peers.end(), senderSteamID));
+        publishPeersLocked(std::move(peers));
+      }
     }
+    liveness_.forget(senderSteamID);
     if (messagesInterface_) {
       SteamNetworkingIdentity identity;
       identity.SetSteamID(senderSteamID);
@@ -420,6 +487,92 @@ void SteamVpnNetworkingManager::handleSessionHello(const uint8_t *data,
             << " version=" << versionForLog << std::endl;
 }
 
+void SteamVpnNetworkingManager::handleKeepalive(const uint8_t *data,
+                                                size_t size,
+                                                CSteamID senderSteamID) {
+  KeepalivePayload payload{};
+  if (size >= sizeof(VpnMessageHeader) + sizeof(KeepalivePayload)) {
+    std::memcpy(&payload, data + sizeof(VpnMessageHeader), sizeof(payload));
+  }
+  std::vector<PeerLiveness::Change> changes;
+  liveness_.noteHeard(senderSteamID, true, PeerLiveness::Clock::now(),
+                      changes);
+  logLivenessChanges(changes);
+  if (payload.flags & KEEPALIVE_FLAG_REPLY) {
+    sendKeepalive(senderSteamID, 0);
+  }
+}
+
+void SteamVpnNetworkingManager::notePeersHeard(
+    const std::vector<CSteamID> &senders) {
+  const auto now = PeerLiveness::Clock::now();
+  std::vector<PeerLiveness::Change> changes;
+  for (const CSteamID &sender : senders) {
+    liveness_.noteHeard(sender, false, now, changes);
+  }
+  logLivenessChanges(changes);
+}
+
+void SteamVpnNetworkingManager::checkPeerLiveness() {
+  if (!messagesInterface_) {
+    return;
+  }
+  std::vector<PeerLiveness::Change> changes;
+  const auto snapshot = peerSnapshot();
+  for (const CSteamID &peer : snapshot->peers) {
+    SteamNetworkingIdentity identity;
+    identity.SetSteamID(peer);
+    const ESteamNetworkingConnectionState state =
+        messagesInterface_->GetSessionConnectionInfo(identity, nullptr,
+                                                     nullptr);
+    liveness_.noteSessionState(
+        peer, state == k_ESteamNetworkingConnectionState_Connected,
+        state == k_ESteamNetworkingConnectionState_ClosedByPeer ||
+            state == k_ESteamNetworkingConnectionState_ProblemDetectedLocally,
+        changes);
+  }
+  std::vector<CSteamID> probe;
+  liveness_.tick(PeerLiveness::Clock::now(), probe, changes);
+  for (const CSteamID &peer : probe) {
+    sendKeepalive(peer, KEEPALIVE_FLAG_REPLY);
+  }
+  logLivenessChanges(changes);
+}
+
+bool SteamVpnNetworkingManager::isPeerDown(CSteamID peerID) const {
+  return liveness_.anyDown() && liveness_.isDown(peerID);
+}
+
+void SteamVpnNetworkingManager::sendKeepalive(CSteamID peerID, uint8_t flags) {
+  if (!messagesInterface_) {
+    return;
+  }
+  VpnMessageHeader header{};
+  header.type = VpnMessageType::KEEPALIVE;
+  header.length = htons(static_cast<uint16_t>(sizeof(KeepalivePayload)));
+  KeepalivePayload payload{};
+  payload.flags = flags;
+  uint8_t buffer[sizeof(VpnMessageHeader) + sizeof(KeepalivePayload)];
+  std::memcpy(buffer, &header, sizeof(VpnMessageHeader));
+  std::memcpy(buffer + sizeof(VpnMessageHeader), &payload, sizeof(payload));
+  SteamNetworkingIdentity identity;
+  identity.SetSteamID(peerID);
+  // Restarting a broken session here is what lets a down peer recover
+  messagesInterface_->SendMessageToUser(
+      identity, buffer, sizeof(buffer),
+      k_nSteamNetworkingSend_UnreliableNoNagle |
+          k_nSteamNetworkingSend_AutoRestartBrokenSession,
+      VPN_CHANNEL);
+}
+
+void SteamVpnNetworkingManager::logLivenessChanges(
+    const std::vector<PeerLiveness::Change> &changes) {
+  for (const auto &change : changes) {
+    std::cout << "[SteamVPN] Peer " << change.peer.ConvertToUint64()
+              << (change.up ? " reachable again" : " unreachable") << std::endl;
+  }
+}
+
 void SteamVpnNetworkingManager::OnSessionRequest(
     SteamNetworkingMessagesSessionRequest_t *pCallback) {
   const CSteamID remoteSteamID = pCallback->m_identityRemote.GetSteamID();
@@ -439,5 +592,9 @@ void SteamVpnNetworkingManager::OnSessionFailed(
   std::cout << "[SteamVPN] Session failed with "
             << remoteSteamID.ConvertToUint64() << ": "
             << pCallback->m_info.m_szEndDebug << std::endl;
-  removePeer(remoteSteamID);
+  // Lobby membership decides removal; a failed session only takes the peer
+  // down until keepalives restart it.
+  std::vector<PeerLiveness::Change> changes;
+  liveness_.noteSessionState(remoteSteamID, false, true, changes);
+  logLivenessChanges(changes);
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "../net/peer_liveness.h"
+#include <memory>
 #include <mutex>
 #include <set>
 #include <steam_api.h>
+#include <vector>
 #include <isteamnetworkingmessages.h>
 #include <steamnetworkingtypes.h>
 #include <string>
@@ -15,6 +18,15 @@ class SteamVpnNetworkingManager {
 public:
   static constexpr int VPN_CHANNEL = 0;
 
+  // Immutable view of the peer set. Every change publishes a new snapshot
+  // with the next generation, so readers never copy or lock.
+  struct PeerSnapshot {
+    uint64_t generation = 0;
+    std::vector<CSteamID> peers; // sorted
+
+    bool contains(CSteamID peerID) const;
+  };
+
   SteamVpnNetworkingManager();
   ~SteamVpnNetworkingManager();
 
@@ -27,12 +39,24 @@ public:
 
   void handleSessionHello(const uint8_t *data, size_t size,
                           CSteamID senderSteamID);
-
+  void handleKeepalive(const uint8_t *data, size_t size,
+                       CSteamID senderSteamID);
+
+  // Called by the message handler once per received batch and on its
+  // liveness tick; see PeerLiveness for the rules.
+  void notePeersHeard(const std::vector<CSteamID> &senders);
+  void checkPeerLiveness();
+  bool isPeerDown(CSteamID peerID) const;
+
+  // Lobby member deltas drive these. addPeer leaves a known peer alone
+  // unless its session is broken; sessions are only closed when broken or
+  // when the peer leaves.
   void addPeer(CSteamID peerID);
   void removePeer(CSteamID peerID);
   void clearPeers();
+  // Reconciles against the full lobby roster in case a delta was missed.
   void syncPeers(const std::set<CSteamID> &desiredPeers);
-  std::set<CSteamID> getPeers() const;
+  std::shared_ptr<const PeerSnapshot> peerSnapshot() const;
 
   int getPeerPing(CSteamID peerID) const;
   bool isPeerConnected(CSteamID peerID) const;
@@ -59,9 +83,19 @@ public:
   }
 
 private:
+  bool isSessionBroken(CSteamID peerID) const;
+  void sendSessionHello(CSteamID peerID);
+  void publishPeersLocked(std::vector<CSteamID> peers);
+  void sendKeepalive(CSteamID peerID, uint8_t flags);
+  void logLivenessChanges(
+      const std::vector<PeerLiveness::Change> &changes);
+
   ISteamNetworkingMessages *messagesInterface_;
-  std::set<CSteamID> peers_;
-  mutable std::mutex peersMutex_;
+  // Written under peersMutex_ (which serializes publishers), read with
+  // std::atomic_load
+  std::shared_ptr<const PeerSnapshot> peers_;
+  std::mutex peersMutex_;
+  PeerLiveness liveness_;
 
   VpnMessageHandler *messageHandler_;
   SteamVpnBridge *vpnBridge_;
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <steam_api.h>
 #include <isteamnetworkingmessages.h>
+#include <vector>
 
 VpnMessageHandler::VpnMessageHandler(ISteamNetworkingMessages *interface,
                                      SteamVpnNetworkingManager *manager)
@@ -99,11 +100,16 @@ void VpnMessageHandler::pollMessages() {
   ISteamNetworkingMessage *incoming[64];
   const int numMsgs =
       interface_->ReceiveMessagesOnChannel(VPN_CHANNEL, incoming, 64);
+  auto &senders = batchSenders_;
+  senders.clear();
   for (int i = 0; i < numMsgs; ++i) {
     ISteamNetworkingMessage *msg = incoming[i];
     const uint8_t *data = static_cast<const uint8_t *>(msg->m_pData);
     const size_t size = msg->m_cbSize;
     const CSteamID sender = msg->m_identityPeer.GetSteamID();
+    if (senders.empty() || senders.back() != sender) {
+      senders.push_back(sender);
+    }
     bool handled = false;
     if (size >= sizeof(VpnMessageHeader)) {
       VpnMessageHeader header;
@@ -113,6 +119,11 @@ void VpnMessageHandler::pollMessages() {
           manager_->handleSessionHello(data, size, sender);
         }
         handled = true;
+      } else if (header.type == VpnMessageType::KEEPALIVE) {
+        if (manager_) {
+          manager_->handleKeepalive(data, size, sender);
+        }
+        handled = true;
       }
     }
     if (!handled && manager_) {
@@ -120,6 +131,16 @@ void VpnMessageHandler::pollMessages() {
     }
     msg->Release();
   }
+  if (manager_) {
+    if (!senders.empty()) {
+      manager_->notePeersHeard(senders);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastLivenessCheck_ >= LIVENESS_INTERVAL) {
+      lastLivenessCheck_ = now;
+      manager_->checkPeerLiveness();
+    }
+  }
   if (numMsgs > 0) {
     currentPollInterval_ = MIN_POLL_INTERVAL;
   } else {
@@ -5,8 +5,10 @@
 #include <chrono>
 #include <isteamnetworkingmessages.h>
 #include <memory>
+#include <steam_api.h>
 #include <steamnetworkingtypes.h>
 #include <thread>
+#include <vector>
 
 class SteamVpnNetworkingManager;
 
@@ -35,9 +37,13 @@ private:
 
   std::atomic<bool> running_;
   std::chrono::microseconds currentPollInterval_;
+  std::chrono::steady_clock::time_point lastLivenessCheck_;
+  // Distinct senders of the current receive batch, reused across polls
+  std::vector<CSteamID> batchSenders_;
 
   static constexpr int VPN_CHANNEL = 0;
   static constexpr std::chrono::microseconds MIN_POLL_INTERVAL{100};
   static constexpr std::chrono::microseconds MAX_POLL_INTERVAL{1000};
   static constexpr std::chrono::microseconds POLL_INCREMENT{100};
+  static constexpr std::chrono::milliseconds LIVENESS_INTERVAL{250};
 };